@@ -71,11 +71,65 @@ LDFLAGS += -luuid -lxrt_coreutil
 ############################## Setting up Kernel Variables ##############################
 # Kernel compiler global settings
 VPP_FLAGS += --save-temps 
+# Largest grid of the runtime-sized kernels, the host buffers and the CPU library.
+MAX_ROW ?= 64
+MAX_COL ?= 64
+VPP_FLAGS += -DMAX_ROW=$(MAX_ROW) -DMAX_COL=$(MAX_COL)
+CXXFLAGS += -DMAX_ROW=$(MAX_ROW) -DMAX_COL=$(MAX_COL)
+
+# Kernel printf diagnostics, 0 (off) to 2 (grid and closed list per call)
+ASEARCH_DEBUG ?= 0
+VPP_FLAGS += -DASEARCH_DEBUG=$(ASEARCH_DEBUG)
+
+# Heuristic policy of the 8-connected kernels: euclidean, octile or chebyshev.
+# HEURISTIC_4C sets the 4-connected kernel's, which may also be manhattan.
+HEURISTIC ?= euclidean
+HEURISTIC_4C ?= $(HEURISTIC)
+ifeq ($(HEURISTIC),manhattan)
+$(error HEURISTIC=manhattan overestimates diagonal steps; use HEURISTIC_4C=manhattan for the 4-connected kernel)
+endif
+VPP_FLAGS += -DASEARCH_HEURISTIC=$(HEURISTIC)Heuristic -DASEARCH_HEURISTIC_4C=$(HEURISTIC_4C)Heuristic
+
+# Nodes expanded per step by -s kbest, and the cost factor its paths may exceed the shortest by.
+KBEST_LANES ?= 4
+KBEST_BOUND ?= 1.0
+VPP_FLAGS += -DKBEST_LANES=$(KBEST_LANES) -DKBEST_BOUND=$(KBEST_BOUND)
 
 
 EXECUTABLE = ./asearch_xrt
 EMCONFIG_DIR = $(TEMP_DIR)
 
+# Kernels linked into asearch.xclbin. asearch is the generic runtime-sized
+# kernel, the others are fixed-size specializations of the same core.
+KERNELS ?= asearch asearch_64x64_8c asearch_32x32_4c asearch_batch asearch_serve asearch_replan asearch_hpa
+KERNEL_XOS = $(foreach k,$(KERNELS),$(TEMP_DIR)/$(k).xo)
+
+# Compute units of asearch and asearch_batch. With more than one, CU n of
+# each gets every memory port on bank CU_MEMORY[n-1], so the platform
+# needs NUM_CU banks of that type (e.g. DDR on U250).
+# With CU_MEMORY=HBM every argument of every CU gets its own pseudo
+# channel instead, handed out in order and wrapping at HBM_CHANNELS.
+# Arguments joined by + share a bundle and so share a channel.
+NUM_CU ?= 1
+CU_MEMORY ?= DDR
+HBM_CHANNELS ?= 32
+CU_PORTS_asearch = gridIn res summary pathOut cellOut
+CU_PORTS_asearch_64x64_8c = $(CU_PORTS_asearch)
+CU_PORTS_asearch_32x32_4c = $(CU_PORTS_asearch)
+CU_PORTS_asearch_batch = gridIn queries results pathOut
+CU_PORTS_asearch_serve = gridIn ring doorbell results+done+pathOut
+CU_PORTS_asearch_replan = gridIn changes res summary pathOut
+CU_PORTS_asearch_hpa = gridIn res summary pathOut
+CU_COUNT = $(if $(filter asearch asearch_batch,$(1)),$(NUM_CU),1)
+CU_SP = $(foreach i,$(shell seq 1 $(NUM_CU)),$(foreach p,$(CU_PORTS_$(1)),--connectivity.sp $(1)_$(i).$(p):$(CU_MEMORY)[$(shell expr $(i) - 1)]))
+HBM_PORTS = $(foreach k,$(KERNELS),$(foreach i,$(shell seq 1 $(call CU_COUNT,$(k))),$(foreach p,$(CU_PORTS_$(k)),$(k)_$(i).$(p))))
+HBM_SP = $(shell n=0; for p in $(HBM_PORTS); do for a in $$(echo $${p#*.} | tr + ' '); do echo "--connectivity.sp $${p%%.*}.$$a:HBM[$$((n % $(HBM_CHANNELS)))]"; done; n=$$((n + 1)); done)
+ifeq ($(CU_MEMORY),HBM)
+VPP_LDFLAGS += $(HBM_SP)
+else ifneq ($(NUM_CU),1)
+VPP_LDFLAGS += $(foreach k,$(filter asearch asearch_batch,$(KERNELS)),$(call CU_SP,$(k)))
+endif
+
 ############################## Setting Targets ##############################
 .PHONY: all clean cleanall docs emconfig
 all: check-platform check-device check-vitis $(EXECUTABLE) $(BUILD_DIR)/asearch.xclbin emconfig
@@ -90,19 +144,50 @@ build: check-vitis check-device $(BUILD_DIR)/asearch.xclbin
 xclbin: build
 
 ############################## Setting Rules for Binary Containers (Building Kernels) ##############################
-$(TEMP_DIR)/asearch.xo: src/asearch_kernel.cpp
+$(TEMP_DIR)/%.xo: src/asearch_kernel.cpp src/asearch_kernel.h
 	mkdir -p $(TEMP_DIR)
-	v++ -c $(VPP_FLAGS) -t $(TARGET) --platform $(PLATFORM) -k asearch --temp_dir $(TEMP_DIR)  -I'$(<D)' -o'$@' '$<' 
+	v++ -c $(VPP_FLAGS) -t $(TARGET) --platform $(PLATFORM) -k $* --temp_dir $(TEMP_DIR)  -I'$(<D)' -o'$@' '$<' 
 
-$(BUILD_DIR)/asearch.xclbin: $(TEMP_DIR)/asearch.xo 
+$(BUILD_DIR)/asearch.xclbin: $(KERNEL_XOS)
 	mkdir -p $(BUILD_DIR)
-	v++ -l $(VPP_FLAGS) $(VPP_LDFLAGS) -t $(TARGET) --platform $(PLATFORM) --temp_dir $(TEMP_DIR) -o'$(LINK_OUTPUT)' $(+) --profile.data all:all:all --connectivity.nk asearch:1
+	v++ -l $(VPP_FLAGS) $(VPP_LDFLAGS) -t $(TARGET) --platform $(PLATFORM) --temp_dir $(TEMP_DIR) -o'$(LINK_OUTPUT)' $(+) --profile.data all:all:all $(foreach k,$(KERNELS),--connectivity.nk $(k):$(call CU_COUNT,$(k)))
 	v++ -p $(LINK_OUTPUT) $(VPP_FLAGS) -t $(TARGET) --platform $(PLATFORM) --package.out_dir $(PACKAGE_OUT) -o $(BUILD_DIR)/asearch.xclbin 
 
 ############################## Setting Rules for Host (Building Host Executable) ##############################
 $(EXECUTABLE): $(HOST_SRCS) | check-xrt
 		g++ -o $@ $^ $(CXXFLAGS) $(LDFLAGS)
 
+############################## Setting Rules for the CPU Library (Building without Vitis) ##############################
+# The search core built natively into libasearch.a and libasearch.so, with
+# the same grid size and search settings as the kernels. Use it through
+# src/asearch_cpu.h, which needs none of the kernel headers.
+CPU_DIR = cpu
+CPU_CXXFLAGS ?= -O3 -DNDEBUG
+CPU_CXXFLAGS += -std=c++1y -fPIC -Wall -Wno-unknown-pragmas -DASEARCH_NATIVE $(filter -D%,$(VPP_FLAGS))
+CPU_OBJS = $(CPU_DIR)/asearch_kernel.o $(CPU_DIR)/asearch_cpu.o
+
+.PHONY: cpu cpu-test
+cpu: $(CPU_DIR)/libasearch.a $(CPU_DIR)/libasearch.so
+
+# The testbench built natively against the library, which adds its CPU
+# library cases to the kernel ones, and again with an 8-cell open list,
+# where the searches have to stop with OPEN_LIST_FULL.
+cpu-test: $(CPU_DIR)/libasearch.a
+	g++ $(CPU_CXXFLAGS) -o $(CPU_DIR)/asearch_test src/asearch_test.cpp $(CPU_DIR)/libasearch.a
+	g++ $(CPU_CXXFLAGS) -DOPEN_MAX=8 -o $(CPU_DIR)/asearch_test_open8 src/asearch_test.cpp src/asearch_kernel.cpp src/asearch_cpu.cpp
+	cp out.gold.aStarSearch.dat $(CPU_DIR)/
+	cd $(CPU_DIR) && ./asearch_test && ./asearch_test_open8
+
+$(CPU_DIR)/%.o: src/%.cpp src/asearch_kernel.h src/asearch_native_stream.h src/asearch_cpu.h
+	mkdir -p $(CPU_DIR)
+	g++ -c $(CPU_CXXFLAGS) -o $@ $<
+
+$(CPU_DIR)/libasearch.a: $(CPU_OBJS)
+	ar rcs $@ $^
+
+$(CPU_DIR)/libasearch.so: $(CPU_OBJS)
+	g++ -shared -o $@ $^
+
 emconfig:$(EMCONFIG_DIR)/emconfig.json
 $(EMCONFIG_DIR)/emconfig.json:
 	emconfigutil --platform $(PLATFORM) --od $(EMCONFIG_DIR)
@@ -130,6 +215,7 @@ clean:
 	-$(RMDIR) $(EXECUTABLE) $(XCLBIN)/{*sw_emu*,*hw_emu*} 
 	-$(RMDIR) profile_* TempConfig system_estimate.xtxt *.rpt *.csv 
 	-$(RMDIR) src/*.ll *v++* .Xil emconfig.json dltmp* xmltmp* *.log *.jou *.wcfg *.wdb
+	-$(RMDIR) $(CPU_DIR)
 
 cleanall: clean
 	-$(RMDIR) build_dir*
@@ -0,0 +1,145 @@
+#include "asearch_cpu.h"
+#include "asearch_kernel.h"
+#include <mutex>
+
+static_assert((int)CPU_PATH_NOT_FOUND == (int)PATH_NOT_FOUND && (int)CPU_PATH_OUTPUT_FULL == (int)PATH_OUTPUT_FULL, "cpuResult out of step with result");
+static_assert((int)CPU_SEARCH_ASTAR == (int)SEARCH_ASTAR && (int)CPU_SEARCH_KBEST == (int)SEARCH_KBEST, "cpuSearch out of step with searchAlgorithm");
+static_assert((int)CPU_OUTPUT_PATH == (int)OUTPUT_PATH && (int)CPU_OUTPUT_COST == (int)OUTPUT_COST, "cpuOutput out of step with outputMode");
+
+// The workspaces of the search core are statics, so only one search may
+// run at a time. The lock also covers each object's grid, so setGrid
+// cannot swap it under a search.
+static std::mutex coreLock;
+
+static Pair toPair(cpuCell c)
+{
+    return make_pair(c.row, c.col);
+}
+
+static cpuCell toCell(Pair p)
+{
+    cpuCell c;
+    c.row = p.first;
+    c.col = p.second;
+    return c;
+}
+
+static cpuSummary toSummary(const pathSummary& s)
+{
+    cpuSummary c;
+    c.length = s.length;
+    c.cost = s.cost;
+    c.expanded = s.expanded;
+    return c;
+}
+
+cpuBackend::cpuBackend() : rows(0), cols(0)
+{
+}
+
+int cpuBackend::maxRows()
+{
+    return MAX_ROW;
+}
+
+int cpuBackend::maxCols()
+{
+    return MAX_COL;
+}
+
+bool cpuBackend::setGrid(const std::vector<int>& grid, int rows, int cols)
+{
+    if (rows < 1 || rows > MAX_ROW || cols < 1 || cols > MAX_COL || (int)grid.size() < rows * cols)
+    {
+        return false;
+    }
+
+    int words = GRID_WORDS(cols);
+    std::vector<unsigned int> next(rows * words, 0);
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            if (grid[i * cols + j])
+            {
+                next[i * words + j / GRID_WORD_BITS] |= 1u << (j % GRID_WORD_BITS);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(coreLock);
+    packed.swap(next);
+    this->rows = rows;
+    this->cols = cols;
+    return true;
+}
+
+int cpuBackend::search(cpuCell src, cpuCell dest, int search, int output, cpuSummary& summary, std::vector<cpuCell>& path)
+{
+    int mode = output == CPU_OUTPUT_PATH ? OUTPUT_PATH : OUTPUT_COST;
+    result r;
+    pathSummary s;
+    std::vector<Pair> pathOut;
+
+    // No grid yet goes to the kernel as a 0x0 grid and comes back as
+    // INVALID_GRID_SIZE.
+    {
+        std::lock_guard<std::mutex> lock(coreLock);
+        pathOut.resize(mode == OUTPUT_PATH ? rows * cols : 0);
+        asearch(packed.data(), rows, cols, toPair(src), toPair(dest), search, mode, &r, &s, pathOut.data(), 0);
+    }
+
+    summary = toSummary(s);
+    path.clear();
+    if (mode == OUTPUT_PATH && r == FOUND_PATH)
+    {
+        for (int i = 0; i < s.length; i++)
+        {
+            path.push_back(toCell(pathOut[i]));
+        }
+    }
+
+    return r;
+}
+
+void cpuBackend::batch(const std::vector<cpuQuery>& queries, int output, std::vector<cpuQueryResult>& results, std::vector<cpuCell>& paths)
+{
+    int mode = output == CPU_OUTPUT_PATH ? OUTPUT_PATH : OUTPUT_COST;
+    int count = queries.size();
+
+    std::vector<query> in(count);
+    for (int q = 0; q < count; q++)
+    {
+        in[q].src = toPair(queries[q].src);
+        in[q].dest = toPair(queries[q].dest);
+        in[q].search = queries[q].search;
+    }
+
+    std::vector<queryResult> out(count);
+    std::vector<Pair> pathOut;
+    {
+        std::lock_guard<std::mutex> lock(coreLock);
+        int capacity = mode == OUTPUT_PATH ? count * rows * cols : 0;
+        pathOut.resize(capacity);
+        asearch_batch(packed.data(), rows, cols, count, in.data(), mode, out.data(), pathOut.data(), capacity);
+    }
+
+    // Found paths are packed in query order, so the last one ends them.
+    results.resize(count);
+    paths.clear();
+    for (int q = 0; q < count; q++)
+    {
+        results[q].result = out[q].r;
+        results[q].summary = toSummary(out[q].summary);
+        results[q].offset = out[q].offset;
+        if (mode == OUTPUT_PATH && out[q].r == FOUND_PATH)
+        {
+            paths.resize(out[q].offset + out[q].summary.length);
+        }
+    }
+
+    for (int i = 0; i < (int)paths.size(); i++)
+    {
+        paths[i] = toCell(pathOut[i]);
+    }
+}
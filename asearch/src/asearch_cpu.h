@@ -0,0 +1,108 @@
+/*
+* CPU backend: the same search core as the kernels, built natively into
+* libasearch (make cpu). This header stands on its own; its codes have
+* the values of the kernel's result, searchAlgorithm and outputMode.
+*/
+#ifndef ASEARCH_CPU_H_
+#define ASEARCH_CPU_H_
+
+#include <vector>
+
+enum cpuResult
+{
+    CPU_PATH_NOT_FOUND = -1,
+    CPU_FOUND_PATH = 0,
+    CPU_INVALID_SOURCE = 1,
+    CPU_INVALID_DESTINATION = 2,
+    CPU_PATH_IS_BLOCKED = 3,
+    CPU_ALREADY_AT_DESTINATION = 4,
+    CPU_OPEN_LIST_FULL = 5,
+    CPU_INVALID_GRID_SIZE = 6,
+    CPU_PATH_OUTPUT_FULL = 7,
+};
+
+enum cpuSearch
+{
+    CPU_SEARCH_ASTAR = 0,
+    CPU_SEARCH_JPS = 1,
+    CPU_SEARCH_BIDIRECTIONAL = 2,
+    CPU_SEARCH_ALT = 3,
+    CPU_SEARCH_KBEST = 4,
+};
+
+// Path mode returns the waypoints, cost mode only the summary.
+enum cpuOutput
+{
+    CPU_OUTPUT_PATH = 1,
+    CPU_OUTPUT_COST = 2,
+};
+
+struct cpuCell
+{
+    int row;
+
+    int col;
+};
+
+// length is the number of waypoints from src to dest inclusive, 0 when
+// no path was found. expanded counts the cells taken off the open list.
+struct cpuSummary
+{
+    int length;
+
+    double cost;
+
+    int expanded;
+};
+
+struct cpuQuery
+{
+    cpuCell src;
+
+    cpuCell dest;
+
+    int search;
+};
+
+// In path mode a found path starts at paths[offset].
+struct cpuQueryResult
+{
+    int result;
+
+    cpuSummary summary;
+
+    int offset;
+};
+
+// Runs queries against one grid, like a device grid on the FPGA. The
+// search state lives in the core, as it does on chip, so calls from all
+// cpuBackend objects in a process take turns on one lock. One object may
+// be shared between threads, setGrid included.
+class cpuBackend
+{
+public:
+    cpuBackend();
+
+    // Takes a rows x cols grid, 1 for an open cell, for the queries that
+    // follow. Returns false and keeps the old grid if the size is
+    // outside what the library was built for (see maxRows and maxCols).
+    bool setGrid(const std::vector<int>& grid, int rows, int cols);
+
+    // One query, as asearch(). output is a cpuOutput; in path mode path
+    // holds the waypoints from src to dest. Returns a cpuResult.
+    int search(cpuCell src, cpuCell dest, int search, int output, cpuSummary& summary, std::vector<cpuCell>& path);
+
+    // A batch, as asearch_batch(). Found paths are packed into paths.
+    void batch(const std::vector<cpuQuery>& queries, int output, std::vector<cpuQueryResult>& results, std::vector<cpuCell>& paths);
+
+    static int maxRows();
+
+    static int maxCols();
+
+private:
+    std::vector<unsigned int> packed;
+    int rows;
+    int cols;
+};
+
+#endif
@@ -23,14 +23,96 @@
 #include <stdlib.h> // for system()
 #include <string>
 #include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <vector>
 
  // XRT includes
 #include "experimental/xrt_bo.h"
 #include "experimental/xrt_device.h"
 #include "experimental/xrt_kernel.h"
 
+int checkGolden(const char* obsFile, const char* expFile);
 bool cmpLine(const string& str1, const string& str2);
-void tracePath(result r, cell cellDetails[][COL], Pair dest);
+void tracePath(result r, cell cellDetails[], int cols, Pair dest);
+void writePath(result r, Pair path[], int length);
+void writeDump(cell cellDetails[], int rows, int cols);
+void packGrid(const int grid[], int rows, int cols, unsigned int packed[]);
+// One set of buffers on a compute unit of asearch_batch and the run using
+// them. count is 0 while the set is idle.
+struct batchUnit
+{
+    xrt::kernel krnl;
+    xrt::bo gridIn;
+    xrt::bo queriesIn;
+    xrt::bo resultsOut;
+    xrt::bo pathOut;
+    xrt::run run;
+    int first;
+    int count;
+};
+
+// Buffers shared with a running asearch_serve kernel, all mapped once.
+// cells is the path room each ring slot gets in pathOut.
+struct serveRing
+{
+    xrt::bo queriesIn;
+    xrt::bo doorbell;
+    xrt::bo resultsOut;
+    xrt::bo done;
+    xrt::bo pathOut;
+    query* queriesIn_map;
+    int* doorbell_map;
+    queryResult* resultsOut_map;
+    int* done_map;
+    Pair* pathOut_map;
+    int size;
+    int cells;
+};
+
+// A packed grid kept on the device between queries. Queries refer to it
+// by its index in bufferPool::grids; a released slot has no map and is
+// reused by the next upload.
+struct deviceGrid
+{
+    xrt::bo bo;
+    unsigned int* map;
+    int rows;
+    int cols;
+};
+
+// Buffers for single queries on one kernel. The output buffers are
+// allocated and mapped once, sized for a MAX_ROW x MAX_COL grid, and
+// reused by every query.
+struct bufferPool
+{
+    xrt::device device;
+    xrt::kernel krnl;
+    std::vector<deviceGrid> grids;
+    xrt::bo resultOut;
+    xrt::bo summaryOut;
+    xrt::bo pathOut;
+    xrt::bo detailsOut;
+    result* resultOut_map;
+    pathSummary* summaryOut_map;
+    Pair* pathOut_map;
+    cell* detailsOut_map;
+};
+
+void openPool(bufferPool& pool, xrt::device& device, const xrt::uuid& uuid, const std::string& kernelName);
+int uploadGrid(bufferPool& pool, const std::vector<int>& grid, int rows, int cols);
+bool updateGrid(bufferPool& pool, int handle, const std::vector<int>& grid, int row, int col, int height, int width);
+void releaseGrid(bufferPool& pool, int handle);
+bool validGrid(const bufferPool& pool, int handle);
+result runQuery(bufferPool& pool, int handle, Pair src, Pair dest, int search, int mode);
+int checkUpdate(bufferPool& pool, int handle, std::vector<int>& grid, Pair src, Pair dest, int search);
+bool readQueries(const char* file, int search, std::vector<query>& queries);
+int runBatch(xrt::device& device, const xrt::uuid& uuid, const std::vector<int>& grid, int rows, int cols, int search, int mode, const std::string& queryFile, int cus, int depth, int chunk);
+int startChunk(batchUnit& unit, const std::vector<query>& queries, int first, int chunk, int rows, int cols, int mode, int pathCells);
+void collectChunk(batchUnit& unit, int mode, std::vector<queryResult>& results, std::vector<Pair>& paths);
+int runServe(xrt::device& device, const xrt::uuid& uuid, const std::vector<int>& grid, int rows, int cols, int search, int mode, const std::string& queryFile, int ringSize);
+void collectSlot(serveRing& ring, int n, int mode, std::vector<queryResult>& results, std::vector<Pair>& paths);
+int writeBatch(const std::vector<query>& queries, const std::vector<queryResult>& results, const std::vector<Pair>& paths, int mode);
 
 int main(int argc, char** argv)
 {
@@ -41,11 +123,33 @@ int main(int argc, char** argv)
     //**************//"<Full Arg>",  "<Short Arg>", "<Description>", "<Default>"
     parser.addSwitch("--xclbin_file", "-x", "input binary file string", "");
     parser.addSwitch("--device_id", "-d", "device index", "0");
+    parser.addSwitch("--grid_file", "-g", "grid file, built-in 9x10 grid if empty", "");
+    parser.addSwitch("--rows", "-r", "grid rows", "9");
+    parser.addSwitch("--cols", "-c", "grid columns", "10");
+    parser.addSwitch("--kernel", "-k", "kernel name, e.g. asearch_64x64_8c for a fixed-size grid", "asearch");
+    parser.addSwitch("--search", "-s", "search algorithm: astar, jps, bidirectional, alt or kbest", "astar");
+    parser.addSwitch("--query_file", "-q", "query file, one \"srcRow srcCol destRow destCol\" per line, run as one batch on asearch_batch", "");
+    parser.addSwitch("--cus", "-n", "compute units of asearch_batch to spread a query file over, see NUM_CU", "1");
+    parser.addSwitch("--depth", "-p", "buffer sets in flight per CU; 1 runs upload, kernel and readback strictly in turn", "2");
+    parser.addSwitch("--chunk", "-b", "queries per batch launch, 0 splits the query file evenly over all buffer sets", "0");
+    parser.addSwitch("--ring", "-R", "ring slots of a persistent asearch_serve kernel to run the query file on, 0 launches asearch_batch instead", "0");
+    parser.addSwitch("--mode", "-m", "output mode: details, path or cost; details also writes dump.dat", "path");
     parser.parse(argc, argv);
 
     // Read settings
     std::string binaryFile = parser.value("xclbin_file");
     int device_index = stoi(parser.value("device_id"));
+    std::string gridFile = parser.value("grid_file");
+    int rows = stoi(parser.value("rows"));
+    int cols = stoi(parser.value("cols"));
+    std::string kernelName = parser.value("kernel");
+    std::string searchName = parser.value("search");
+    std::string modeName = parser.value("mode");
+    std::string queryFile = parser.value("query_file");
+    int cus = stoi(parser.value("cus"));
+    int depth = stoi(parser.value("depth"));
+    int chunk = stoi(parser.value("chunk"));
+    int ringSize = stoi(parser.value("ring"));
 
     if (argc < 3)
     {
@@ -53,14 +157,76 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
+    if (rows < 1 || rows > MAX_ROW || cols < 1 || cols > MAX_COL)
+    {
+        std::cout << "Grid must be between 1x1 and " << MAX_ROW << "x" << MAX_COL << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int search;
+    if (searchName == "astar")
+    {
+        search = SEARCH_ASTAR;
+    }
+    else if (searchName == "jps")
+    {
+        search = SEARCH_JPS;
+    }
+    else if (searchName == "bidirectional")
+    {
+        search = SEARCH_BIDIRECTIONAL;
+    }
+    else if (searchName == "alt")
+    {
+        search = SEARCH_ALT;
+    }
+    else if (searchName == "kbest")
+    {
+        search = SEARCH_KBEST;
+    }
+    else
+    {
+        std::cout << "Unknown search " << searchName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int mode;
+    if (modeName == "details")
+    {
+        mode = OUTPUT_DETAILS;
+    }
+    else if (modeName == "path")
+    {
+        mode = OUTPUT_PATH;
+    }
+    else if (modeName == "cost")
+    {
+        mode = OUTPUT_COST;
+    }
+    else
+    {
+        std::cout << "Unknown output mode " << modeName << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (cus < 1 || depth < 1)
+    {
+        std::cout << "Need at least one compute unit and one buffer set" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (gridFile.empty() && (rows != 9 || cols != 10))
+    {
+        std::cout << "The built-in grid is 9x10, use --grid_file for other sizes" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     std::cout << "Open the device" << device_index << std::endl;
     auto device = xrt::device(device_index);
     std::cout << "Load the xclbin " << binaryFile << std::endl;
     auto uuid = device.load_xclbin(binaryFile);
 
-    auto krnl = xrt::kernel(device, uuid, "asearch");
-
-    int grid[ROW][COL] =
+    int sampleGrid[9][10] =
     {
         {1,0,1,1,1,1,0,1,1,1},
         {1,1,1,0,1,1,1,0,1,1},
@@ -68,67 +234,128 @@ int main(int argc, char** argv)
         {0,0,1,0,1,0,0,0,0,1},
         {1,1,1,0,1,1,1,0,1,0},
         {1,0,1,1,1,1,0,1,0,0},
+        {1,0,0,0,0,1,0,0,0,1},
         {1,0,1,1,1,1,0,1,1,1},
         {1,1,1,0,0,0,1,0,0,1}
     };
-    auto gridIn = xrt::bo(device, ROW * COL * sizeof(int), krnl.group_id(0));
-    auto resultOut = xrt::bo(device, sizeof(result), krnl.group_id(3));
-    auto detailsOut = xrt::bo(device, ROW * COL * sizeof(cell), krnl.group_id(4));
+    std::vector<int> grid(rows * cols);
+    if (!gridFile.empty())
+    {
+        if (!readGrid(gridFile.c_str(), grid.data(), rows, cols))
+        {
+            std::cout << "Could not read a " << rows << "x" << cols << " grid from " << gridFile << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    auto gridIn_map = gridIn.map<int*>();
-    auto detailsOut_map = detailsOut.map<cell*>();
-    Pair src = make_pair(8, 0);
-    Pair dest = make_pair(0, 0);
-    result* r = resultOut.map<result*>();
-    *r = result::PATH_NOT_FOUND;
-    for (int i = 0; i < ROW; i++)
+    for (int i = 0; i < rows; i++)
     {
-        for (int j = 0; j < COL; j++)
+        for (int j = 0; j < cols; j++)
         {
-            gridIn_map[i * COL + j] = grid[i][j];
-            detailsOut_map[i * COL + j] = cell();
+            if (gridFile.empty())
+            {
+                grid[i * cols + j] = sampleGrid[i][j];
+            }
         }
     }
 
-    std::cout << "Synchronize Data In" << std::endl;
-    gridIn.sync(XCL_BO_SYNC_BO_TO_DEVICE);
-    resultOut.sync(XCL_BO_SYNC_BO_TO_DEVICE);
-    detailsOut.sync(XCL_BO_SYNC_BO_TO_DEVICE);
+    if (!queryFile.empty() && ringSize > 0)
+    {
+        return runServe(device, uuid, grid, rows, cols, search, mode, queryFile, ringSize);
+    }
+
+    if (!queryFile.empty())
+    {
+        return runBatch(device, uuid, grid, rows, cols, search, mode, queryFile, cus, depth, chunk);
+    }
+
+    bufferPool pool;
+    openPool(pool, device, uuid, kernelName);
+
+    Pair src = make_pair(8, 0);
+    Pair dest = make_pair(0, 0);
+
+    std::cout << "Upload the grid" << std::endl;
+    int handle = uploadGrid(pool, grid, rows, cols);
 
     std::cout << "Execution of the kernel" << std::endl;
-    auto run = krnl(gridIn, src, dest, resultOut, detailsOut);
-    run.wait();
+    result r = runQuery(pool, handle, src, dest, search, mode);
+    std::cout << "Expanded " << pool.summaryOut_map->expanded << " cells" << std::endl;
 
-    std::cout << "Synchronize Data Out" << std::endl;
-    resultOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE);
-    detailsOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE);
+    if (mode == OUTPUT_COST)
+    {
+        std::cout << "Result: " << r << std::endl;
+        std::cout << "Path cost: " << pool.summaryOut_map->cost << " over " << pool.summaryOut_map->length << " cells" << std::endl;
+        return 0;
+    }
 
-    // Transpose to multi dimension array
-    cell details[ROW][COL];
-    for (int i = 0; i < ROW; i++)
+    if (mode == OUTPUT_PATH)
+    {
+        writePath(r, pool.pathOut_map, pool.summaryOut_map->length);
+    }
+    else
     {
-        for (int j = 0; j < COL; j++)
+        tracePath(r, pool.detailsOut_map, cols, dest);
+
+        // Queries rejected before the search leave cellOut untouched.
+        if (pool.summaryOut_map->expanded > 0)
         {
-            details[i][j] = detailsOut_map[i * COL + j];
+            writeDump(pool.detailsOut_map, rows, cols);
         }
     }
 
-    tracePath(*r, details, dest);
+    if (mode == OUTPUT_PATH && r == FOUND_PATH)
+    {
+        int status = checkUpdate(pool, handle, grid, src, dest, search);
+        if (status != 0)
+        {
+            return status;
+        }
+    }
+
+    // A released handle has to be refused, and its slot has to go to the
+    // next upload.
+    releaseGrid(pool, handle);
+    if (runQuery(pool, handle, src, dest, search, mode) != INVALID_GRID_SIZE || uploadGrid(pool, grid, rows, cols) != handle)
+    {
+        std::cout << "*******************************************" << std::endl;
+        std::cout << "FAIL: Released grid handle was not refused or reused" << std::endl;
+        std::cout << "*******************************************" << std::endl;
+        return 4;
+    }
 
     // Comparing results with the golden output.
+    int status = checkGolden("out.dat", "out.gold.aStarSearch.dat");
+    if (status != 0)
+    {
+        return status;
+    }
+
+    std::cout << "*******************************************" << std::endl;
+    std::cout << "PASS: The output matches the golden output" << std::endl;
+    std::cout << "*******************************************" << std::endl;
+
+    return 0;
+}
+
+int checkGolden(const char* obsFile, const char* expFile)
+{
     std::cout << "Comparing observed against expected data" << std::endl;
 
     std::ifstream file_obs, file_exp;
-    file_obs.open("out.dat");
-    file_exp.open("out.gold.aStarSearch.dat");
-    bool hasDataObs = true, hasDataExp = true;
+    file_obs.open(obsFile);
+    file_exp.open(expFile);
 
-    for (unsigned int i = 1; hasDataObs && hasDataExp; i++)
+    std::string obs, exp;
+    for (unsigned int i = 1; ; i++)
     {
-        std::string obs, exp;
-        std::getline(file_obs, obs);
+        bool hasDataObs = static_cast<bool>(std::getline(file_obs, obs));
+        bool hasDataExp = static_cast<bool>(std::getline(file_exp, exp));
 
-        std::getline(file_exp, exp);
+        if (!hasDataObs && !hasDataExp)
+        {
+            break;
+        }
 
         if (hasDataExp && !hasDataObs) // They don't agree on number of line in output
         {
@@ -157,14 +384,7 @@ int main(int argc, char** argv)
             std::cout << "*******************************************" << std::endl;
             return 1;
         }
-
-        hasDataObs = file_obs.eof();
-        hasDataExp = file_exp.eof();
-    } while (hasDataObs && hasDataExp);
-
-    std::cout << "*******************************************" << std::endl;
-    std::cout << "PASS: The output matches the golden output" << std::endl;
-    std::cout << "*******************************************" << std::endl;
+    }
 
     return 0;
 }
@@ -186,16 +406,42 @@ bool cmpLine(const string& str1, const string& str2)
     return match;
 }
 
-void tracePath(result r, cell cellDetails[][COL], Pair dest)
+void tracePath(result r, cell cellDetails[], int cols, Pair dest)
 {
-    std::cout << "Result: " << r << endl;
-    //    std::cout << "Dest: " << dest << endl;
-    std::ofstream output;
     int row = dest.first;
     int col = dest.second;
+    stack<Pair> Path;
+    vector<Pair> ordered;
+
+    if (r == FOUND_PATH)
+    {
+        while (!(cellDetails[row * cols + col].parent_i == row &&
+            cellDetails[row * cols + col].parent_j == col))
+        {
+            Path.push(make_pair(row, col));
+            int tempRow = cellDetails[row * cols + col].parent_i;
+            int tempCol = cellDetails[row * cols + col].parent_j;
+            row = tempRow;
+            col = tempCol;
+        }
+
+        Path.push(make_pair(row, col));
+        while (!Path.empty())
+        {
+            ordered.push_back(Path.top());
+            Path.pop();
+        }
+    }
+
+    writePath(r, ordered.data(), ordered.size());
+}
+
+void writePath(result r, Pair path[], int length)
+{
+    std::cout << "Result: " << r << endl;
+    std::ofstream output;
 
     output.open("out.dat", std::ofstream::trunc);
-    Pair Path[ROW * COL];
 
     switch (r)
     {
@@ -203,26 +449,11 @@ void tracePath(result r, cell cellDetails[][COL], Pair dest)
         {
             output << "The destination cell is found" << std::endl << std::endl;
 
-            output << "The path is " << std::endl;
-
-            int idx = 0;
-            while (!(cellDetails[row][col].parent_i == row &&
-                cellDetails[row][col].parent_j == col))
-            {
-                Path[idx] = make_pair(row, col);
-                idx++;
-                int tempRow = cellDetails[row][col].parent_i;
-                int tempCol = cellDetails[row][col].parent_j;
-                row = tempRow;
-                col = tempCol;
-            }
-
+            output << "The Path is " << std::endl;
 
-            Path[idx] = make_pair(row, col);
-            for (int i = idx; i >= 0; i--)
+            for (int i = 0; i < length; i++)
             {
-                Pair p = Path[i];
-                output << "(" << p.first << "," << p.second << ")" << endl;
+                output << "(" << path[i].first << "," << path[i].second << ")" << endl;
             }
         }
         break;
@@ -246,8 +477,617 @@ void tracePath(result r, cell cellDetails[][COL], Pair dest)
         case PATH_NOT_FOUND:
             output << "Path was not found";
             break;
+
+        case OPEN_LIST_FULL:
+            output << "Open list capacity exceeded";
+            break;
+
+        case INVALID_GRID_SIZE:
+            output << "Grid size is invalid";
+            break;
+
+        case PATH_OUTPUT_FULL:
+            output << "Path does not fit the output buffer";
+            break;
     }
 
     output.flush();
     output.close();
 }
+
+bool readGrid(const char* file, int grid[], int rows, int cols)
+{
+    FILE* pFile = fopen(file, "r");
+    if (pFile == NULL)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    int val;
+    for (int i = 0; ok && i < rows; i++)
+    {
+        for (int j = 0; ok && j < cols; j++)
+        {
+            ok = fscanf(pFile, "%i", &val) == 1;
+            grid[i * cols + j] = val;
+        }
+    }
+
+    fclose(pFile);
+    return ok;
+}
+
+void packGrid(const int grid[], int rows, int cols, unsigned int packed[])
+{
+    int words = GRID_WORDS(cols);
+    for (int i = 0; i < rows * words; i++)
+    {
+        packed[i] = 0;
+    }
+
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            if (grid[i * cols + j] == 1)
+            {
+                packed[i * words + j / GRID_WORD_BITS] |= 1u << (j % GRID_WORD_BITS);
+            }
+        }
+    }
+}
+
+// One line per reached cell: position, open/closed state, parent and f, g, h.
+void writeDump(cell cellDetails[], int rows, int cols)
+{
+    std::ofstream output;
+    output.open("dump.dat", std::ofstream::trunc);
+
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            cell c = cellDetails[i * cols + j];
+            if (c.state == CELL_UNREACHED)
+            {
+                continue;
+            }
+
+            output << "(" << i << "," << j << ") "
+                << (c.state == CELL_CLOSED ? "closed" : "open")
+                << " parent (" << c.parent_i << "," << c.parent_j << ")"
+                << " f " << c.f << " g " << c.g << " h " << c.h << std::endl;
+        }
+    }
+
+    output.close();
+}
+
+bool readQueries(const char* file, int search, std::vector<query>& queries)
+{
+    FILE* pFile = fopen(file, "r");
+    if (pFile == NULL)
+    {
+        return false;
+    }
+
+    query q;
+    q.search = search;
+    while (fscanf(pFile, "%i %i %i %i", &q.src.first, &q.src.second, &q.dest.first, &q.dest.second) == 4)
+    {
+        queries.push_back(q);
+    }
+
+    fclose(pFile);
+    return !queries.empty();
+}
+
+// Runs the queries in queryFile on cus compute units of asearch_batch with
+// depth launches in flight on each, chunk queries per launch, and writes
+// one block per query to batch.dat.
+int runBatch(xrt::device& device, const xrt::uuid& uuid, const std::vector<int>& grid, int rows, int cols, int search, int mode, const std::string& queryFile, int cus, int depth, int chunk)
+{
+    std::vector<query> queries;
+    if (!readQueries(queryFile.c_str(), search, queries))
+    {
+        std::cout << "Could not read any queries from " << queryFile << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (mode == OUTPUT_DETAILS)
+    {
+        std::cout << "Batches return paths or costs only, use -m path or -m cost" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int count = queries.size();
+    if (chunk < 1)
+    {
+        chunk = (count + cus * depth - 1) / (cus * depth);
+    }
+
+    // No path is longer than the grid has cells, so this always fits.
+    int pathCells = mode == OUTPUT_PATH ? chunk * rows * cols : 1;
+
+    // Each CU sits on its own memory bank, so it gets its own kernel
+    // handle and buffers, and its own copy of the grid.
+    std::vector<xrt::kernel> kernels(cus);
+    std::vector<xrt::bo> grids(cus);
+    for (int c = 0; c < cus; c++)
+    {
+        kernels[c] = xrt::kernel(device, uuid, "asearch_batch:{asearch_batch_" + std::to_string(c + 1) + "}");
+        grids[c] = xrt::bo(device, rows * GRID_WORDS(cols) * sizeof(unsigned int), kernels[c].group_id(0));
+
+        packGrid(grid.data(), rows, cols, grids[c].map<unsigned int*>());
+        grids[c].sync(XCL_BO_SYNC_BO_TO_DEVICE);
+    }
+
+    // depth buffer sets per CU, unit u on CU u % cus. While a CU runs one
+    // set, the host fills the next and drains the one before it, and XRT
+    // queues the next run behind the current one.
+    int slots = cus * depth;
+    std::vector<batchUnit> units(slots);
+    for (int u = 0; u < slots; u++)
+    {
+        batchUnit& unit = units[u];
+        unit.krnl = kernels[u % cus];
+        unit.gridIn = grids[u % cus];
+        unit.queriesIn = xrt::bo(device, chunk * sizeof(query), unit.krnl.group_id(4));
+        unit.resultsOut = xrt::bo(device, chunk * sizeof(queryResult), unit.krnl.group_id(6));
+        unit.pathOut = xrt::bo(device, pathCells * sizeof(Pair), unit.krnl.group_id(7));
+        unit.count = 0;
+    }
+
+    std::cout << "Execution of " << count << " queries on " << cus << " compute units, " << depth << " deep" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<queryResult> results(count);
+    std::vector<Pair> paths;
+    int next = 0;
+    int busy = 0;
+    for (int u = 0; u < slots && next < count; u++)
+    {
+        next += startChunk(units[u], queries, next, chunk, rows, cols, mode, pathCells);
+        busy++;
+    }
+
+    // Poll every unit in flight and refill whichever has finished, so a
+    // CU through its chunk early does not wait behind a slower one. When
+    // none has, block briefly on the first busy one.
+    while (busy > 0)
+    {
+        int first = -1;
+        bool finished = false;
+        for (int u = 0; u < slots; u++)
+        {
+            if (units[u].count == 0)
+            {
+                continue;
+            }
+
+            ert_cmd_state state = units[u].run.state();
+            if (state == ERT_CMD_STATE_ERROR || state == ERT_CMD_STATE_ABORT)
+            {
+                std::cout << "Run of queries " << units[u].first << " to " << units[u].first + units[u].count - 1 << " failed" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            if (state != ERT_CMD_STATE_COMPLETED)
+            {
+                first = first < 0 ? u : first;
+                continue;
+            }
+
+            collectChunk(units[u], mode, results, paths);
+            units[u].count = 0;
+            busy--;
+            finished = true;
+
+            if (next < count)
+            {
+                next += startChunk(units[u], queries, next, chunk, rows, cols, mode, pathCells);
+                busy++;
+            }
+        }
+
+        if (!finished && first >= 0)
+        {
+            units[first].run.wait(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Ran " << count << " queries in " << elapsed.count() << " ms" << std::endl;
+
+    return writeBatch(queries, results, paths, mode);
+}
+
+// Writes one block per query to batch.dat; found paths start at
+// paths[offset].
+int writeBatch(const std::vector<query>& queries, const std::vector<queryResult>& results, const std::vector<Pair>& paths, int mode)
+{
+    int count = queries.size();
+    std::ofstream output;
+    output.open("batch.dat", std::ofstream::trunc);
+
+    int found = 0;
+    for (int q = 0; q < count; q++)
+    {
+        queryResult res = results[q];
+        output << "Query " << q << " (" << queries[q].src.first << "," << queries[q].src.second << ") -> ("
+            << queries[q].dest.first << "," << queries[q].dest.second << "): result " << res.r
+            << " length " << res.summary.length << " cost " << res.summary.cost
+            << " expanded " << res.summary.expanded << std::endl;
+
+        if (res.r == FOUND_PATH)
+        {
+            found++;
+        }
+
+        if (mode == OUTPUT_PATH && res.r == FOUND_PATH)
+        {
+            for (int i = 0; i < res.summary.length; i++)
+            {
+                Pair p = paths[res.offset + i];
+                output << "(" << p.first << "," << p.second << ")" << std::endl;
+            }
+        }
+    }
+
+    output.close();
+
+    std::cout << "Found " << found << " of " << count << " paths, written to batch.dat" << std::endl;
+    return 0;
+}
+
+// Hands unit the queries from first on, at most chunk of them, and
+// returns how many it took.
+int startChunk(batchUnit& unit, const std::vector<query>& queries, int first, int chunk, int rows, int cols, int mode, int pathCells)
+{
+    int n = std::min(chunk, (int)queries.size() - first);
+    auto queriesIn_map = unit.queriesIn.map<query*>();
+    for (int q = 0; q < n; q++)
+    {
+        queriesIn_map[q] = queries[first + q];
+    }
+
+    unit.queriesIn.sync(XCL_BO_SYNC_BO_TO_DEVICE, n * sizeof(query), 0);
+    unit.run = unit.krnl(unit.gridIn, rows, cols, n, unit.queriesIn, mode, unit.resultsOut, unit.pathOut, pathCells);
+    unit.first = first;
+    unit.count = n;
+
+    return n;
+}
+
+// Copies a finished chunk's results into results, moving its paths onto
+// the end of paths and pointing the offsets there.
+void collectChunk(batchUnit& unit, int mode, std::vector<queryResult>& results, std::vector<Pair>& paths)
+{
+    unit.resultsOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE, unit.count * sizeof(queryResult), 0);
+    auto resultsOut_map = unit.resultsOut.map<queryResult*>();
+
+    // Paths are packed in query order, so the last found one ends the data.
+    int pathUsed = 0;
+    for (int q = 0; q < unit.count; q++)
+    {
+        if (resultsOut_map[q].r == FOUND_PATH)
+        {
+            pathUsed = resultsOut_map[q].offset + resultsOut_map[q].summary.length;
+        }
+    }
+
+    if (mode == OUTPUT_PATH && pathUsed > 0)
+    {
+        unit.pathOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE, pathUsed * sizeof(Pair), 0);
+    }
+
+    auto pathOut_map = unit.pathOut.map<Pair*>();
+    for (int q = 0; q < unit.count; q++)
+    {
+        queryResult res = resultsOut_map[q];
+        int offset = paths.size();
+        if (mode == OUTPUT_PATH && res.r == FOUND_PATH)
+        {
+            paths.insert(paths.end(), pathOut_map + res.offset, pathOut_map + res.offset + res.summary.length);
+        }
+
+        res.offset = offset;
+        results[unit.first + q] = res;
+    }
+
+    unit.count = 0;
+}
+
+void openPool(bufferPool& pool, xrt::device& device, const xrt::uuid& uuid, const std::string& kernelName)
+{
+    pool.device = device;
+    pool.krnl = xrt::kernel(device, uuid, kernelName);
+    pool.resultOut = xrt::bo(device, sizeof(result), pool.krnl.group_id(7));
+    pool.summaryOut = xrt::bo(device, sizeof(pathSummary), pool.krnl.group_id(8));
+    pool.pathOut = xrt::bo(device, MAX_ROW * MAX_COL * sizeof(Pair), pool.krnl.group_id(9));
+    pool.detailsOut = xrt::bo(device, MAX_ROW * MAX_COL * sizeof(cell), pool.krnl.group_id(10));
+
+    pool.resultOut_map = pool.resultOut.map<result*>();
+    pool.summaryOut_map = pool.summaryOut.map<pathSummary*>();
+    pool.pathOut_map = pool.pathOut.map<Pair*>();
+    pool.detailsOut_map = pool.detailsOut.map<cell*>();
+}
+
+// Packs grid into a new device buffer and returns its handle, the first
+// released one if there is any.
+int uploadGrid(bufferPool& pool, const std::vector<int>& grid, int rows, int cols)
+{
+    deviceGrid g;
+    g.bo = xrt::bo(pool.device, rows * GRID_WORDS(cols) * sizeof(unsigned int), pool.krnl.group_id(0));
+    g.map = g.bo.map<unsigned int*>();
+    g.rows = rows;
+    g.cols = cols;
+
+    packGrid(grid.data(), rows, cols, g.map);
+    g.bo.sync(XCL_BO_SYNC_BO_TO_DEVICE);
+
+    for (int h = 0; h < (int)pool.grids.size(); h++)
+    {
+        if (!validGrid(pool, h))
+        {
+            pool.grids[h] = g;
+            return h;
+        }
+    }
+
+    pool.grids.push_back(g);
+    return pool.grids.size() - 1;
+}
+
+// Frees the device buffer behind handle. The handle is invalid until an
+// upload reuses it.
+void releaseGrid(bufferPool& pool, int handle)
+{
+    if (validGrid(pool, handle))
+    {
+        pool.grids[handle] = deviceGrid();
+    }
+}
+
+bool validGrid(const bufferPool& pool, int handle)
+{
+    return handle >= 0 && handle < (int)pool.grids.size() && pool.grids[handle].map != nullptr;
+}
+
+// Repacks the height x width tile at (row, col) from grid, the full
+// updated map, and syncs only the words that hold it. Returns false and
+// changes nothing if handle or the tile is outside the uploaded grids.
+bool updateGrid(bufferPool& pool, int handle, const std::vector<int>& grid, int row, int col, int height, int width)
+{
+    if (!validGrid(pool, handle))
+    {
+        return false;
+    }
+
+    deviceGrid& g = pool.grids[handle];
+    if (row < 0 || col < 0 || height < 1 || width < 1 ||
+        row + height > g.rows || col + width > g.cols ||
+        (int)grid.size() < g.rows * g.cols)
+    {
+        return false;
+    }
+
+    int words = GRID_WORDS(g.cols);
+    int firstWord = col / GRID_WORD_BITS;
+    int lastWord = (col + width - 1) / GRID_WORD_BITS;
+
+    for (int i = row; i < row + height; i++)
+    {
+        for (int w = firstWord; w <= lastWord; w++)
+        {
+            unsigned int word = 0;
+            for (int b = 0; b < GRID_WORD_BITS && w * GRID_WORD_BITS + b < g.cols; b++)
+            {
+                if (grid[i * g.cols + w * GRID_WORD_BITS + b] == 1)
+                {
+                    word |= 1u << b;
+                }
+            }
+
+            g.map[i * words + w] = word;
+        }
+    }
+
+    // Rows are contiguous, so a full-width update is one sync; a narrower
+    // tile takes one per row.
+    size_t wordBytes = sizeof(unsigned int);
+    if (firstWord == 0 && lastWord == words - 1)
+    {
+        g.bo.sync(XCL_BO_SYNC_BO_TO_DEVICE, height * words * wordBytes, row * words * wordBytes);
+        return true;
+    }
+
+    for (int i = row; i < row + height; i++)
+    {
+        g.bo.sync(XCL_BO_SYNC_BO_TO_DEVICE, (lastWord - firstWord + 1) * wordBytes, (i * words + firstWord) * wordBytes);
+    }
+
+    return true;
+}
+
+// Runs one query against a grid already on the device, so nothing but
+// the kernel arguments goes across; of the outputs only what mode wrote
+// comes back. An unknown or released handle gives INVALID_GRID_SIZE.
+result runQuery(bufferPool& pool, int handle, Pair src, Pair dest, int search, int mode)
+{
+    if (!validGrid(pool, handle))
+    {
+        *pool.resultOut_map = INVALID_GRID_SIZE;
+        *pool.summaryOut_map = pathSummary();
+        return INVALID_GRID_SIZE;
+    }
+
+    deviceGrid& g = pool.grids[handle];
+    int rows = g.rows;
+    int cols = g.cols;
+
+    auto run = pool.krnl(g.bo, rows, cols, src, dest, search, mode, pool.resultOut, pool.summaryOut, pool.pathOut, pool.detailsOut);
+    run.wait();
+
+    pool.resultOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE);
+    pool.summaryOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE);
+
+    // Only read back the waypoints the kernel wrote.
+    if (mode == OUTPUT_PATH && pool.summaryOut_map->length > 0)
+    {
+        pool.pathOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE, pool.summaryOut_map->length * sizeof(Pair), 0);
+    }
+
+    if (mode == OUTPUT_DETAILS)
+    {
+        pool.detailsOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE, rows * cols * sizeof(cell), 0);
+    }
+
+    return *pool.resultOut_map;
+}
+
+// Runs the queries in queryFile through one asearch_serve kernel that is
+// started once. Each query costs a ring write and a doorbell write; a
+// slot is reused only after the kernel has marked its last query done.
+int runServe(xrt::device& device, const xrt::uuid& uuid, const std::vector<int>& grid, int rows, int cols, int search, int mode, const std::string& queryFile, int ringSize)
+{
+    std::vector<query> queries;
+    if (!readQueries(queryFile.c_str(), search, queries))
+    {
+        std::cout << "Could not read any queries from " << queryFile << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (mode == OUTPUT_DETAILS)
+    {
+        std::cout << "Batches return paths or costs only, use -m path or -m cost" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto krnl = xrt::kernel(device, uuid, "asearch_serve");
+    auto gridIn = xrt::bo(device, rows * GRID_WORDS(cols) * sizeof(unsigned int), krnl.group_id(0));
+    packGrid(grid.data(), rows, cols, gridIn.map<unsigned int*>());
+    gridIn.sync(XCL_BO_SYNC_BO_TO_DEVICE);
+
+    serveRing ring;
+    ring.size = ringSize;
+    ring.cells = rows * cols;
+    ring.queriesIn = xrt::bo(device, ringSize * sizeof(query), krnl.group_id(3));
+    ring.doorbell = xrt::bo(device, 2 * sizeof(int), krnl.group_id(4));
+    ring.resultsOut = xrt::bo(device, ringSize * sizeof(queryResult), krnl.group_id(5));
+    ring.done = xrt::bo(device, ringSize * sizeof(int), krnl.group_id(6));
+    ring.pathOut = xrt::bo(device, ringSize * ring.cells * sizeof(Pair), krnl.group_id(7));
+    ring.queriesIn_map = ring.queriesIn.map<query*>();
+    ring.doorbell_map = ring.doorbell.map<int*>();
+    ring.resultsOut_map = ring.resultsOut.map<queryResult*>();
+    ring.done_map = ring.done.map<int*>();
+    ring.pathOut_map = ring.pathOut.map<Pair*>();
+
+    ring.doorbell_map[DOORBELL_TAIL] = 0;
+    ring.doorbell_map[DOORBELL_STOP] = 0;
+    ring.doorbell.sync(XCL_BO_SYNC_BO_TO_DEVICE);
+    std::fill(ring.done_map, ring.done_map + ringSize, 0);
+    ring.done.sync(XCL_BO_SYNC_BO_TO_DEVICE);
+
+    int count = queries.size();
+    std::cout << "Execution of " << count << " queries on a persistent kernel with " << ringSize << " ring slots" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+
+    auto run = krnl(gridIn, rows, cols, ring.queriesIn, ring.doorbell, ring.resultsOut, ring.done, ring.pathOut, ringSize, mode);
+
+    std::vector<queryResult> results(count);
+    std::vector<Pair> paths;
+    for (int n = 0; n < count; n++)
+    {
+        int slot = n % ringSize;
+        if (n >= ringSize)
+        {
+            collectSlot(ring, n - ringSize, mode, results, paths);
+        }
+
+        ring.queriesIn_map[slot] = queries[n];
+        ring.queriesIn.sync(XCL_BO_SYNC_BO_TO_DEVICE, sizeof(query), slot * sizeof(query));
+        ring.doorbell_map[DOORBELL_TAIL] = n + 1;
+        ring.doorbell.sync(XCL_BO_SYNC_BO_TO_DEVICE, sizeof(int), DOORBELL_TAIL * sizeof(int));
+    }
+
+    for (int n = std::max(0, count - ringSize); n < count; n++)
+    {
+        collectSlot(ring, n, mode, results, paths);
+    }
+
+    ring.doorbell_map[DOORBELL_STOP] = 1;
+    ring.doorbell.sync(XCL_BO_SYNC_BO_TO_DEVICE, sizeof(int), DOORBELL_STOP * sizeof(int));
+    run.wait();
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Ran " << count << " queries in " << elapsed.count() << " ms" << std::endl;
+
+    return writeBatch(queries, results, paths, mode);
+}
+
+// Waits until the kernel marks query n done, then copies its result into
+// results and its path onto the end of paths.
+void collectSlot(serveRing& ring, int n, int mode, std::vector<queryResult>& results, std::vector<Pair>& paths)
+{
+    int slot = n % ring.size;
+    do
+    {
+        ring.done.sync(XCL_BO_SYNC_BO_FROM_DEVICE, sizeof(int), slot * sizeof(int));
+    } while (ring.done_map[slot] != n + 1);
+
+    ring.resultsOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE, sizeof(queryResult), slot * sizeof(queryResult));
+    queryResult res = ring.resultsOut_map[slot];
+    int offset = paths.size();
+    if (mode == OUTPUT_PATH && res.r == FOUND_PATH)
+    {
+        ring.pathOut.sync(XCL_BO_SYNC_BO_FROM_DEVICE, res.summary.length * sizeof(Pair), res.offset * sizeof(Pair));
+        paths.insert(paths.end(), ring.pathOut_map + res.offset, ring.pathOut_map + res.offset + res.summary.length);
+    }
+
+    res.offset = offset;
+    results[n] = res;
+}
+
+// Blocks a cell in the middle of the path just found with updateGrid,
+// which has to send the next query around it, then clears it again,
+// which has to give the original cost back.
+int checkUpdate(bufferPool& pool, int handle, std::vector<int>& grid, Pair src, Pair dest, int search)
+{
+    int length = pool.summaryOut_map->length;
+    double cost = pool.summaryOut_map->cost;
+    if (length < 3)
+    {
+        return 0;
+    }
+
+    Pair mid = pool.pathOut_map[length / 2];
+    int cols = pool.grids[handle].cols;
+
+    std::cout << "Block (" << mid.first << "," << mid.second << ") and rerun" << std::endl;
+    grid[mid.first * cols + mid.second] = 0;
+    bool updated = updateGrid(pool, handle, grid, mid.first, mid.second, 1, 1);
+    result r = updated ? runQuery(pool, handle, src, dest, search, OUTPUT_PATH) : PATH_NOT_FOUND;
+
+    bool avoided = updated;
+    for (int i = 0; avoided && r == FOUND_PATH && i < pool.summaryOut_map->length; i++)
+    {
+        avoided = pool.pathOut_map[i] != mid;
+    }
+
+    std::cout << "Clear (" << mid.first << "," << mid.second << ") and rerun" << std::endl;
+    grid[mid.first * cols + mid.second] = 1;
+    updated = updateGrid(pool, handle, grid, mid.first, mid.second, 1, 1) && updated;
+    r = updated ? runQuery(pool, handle, src, dest, search, OUTPUT_PATH) : PATH_NOT_FOUND;
+
+    if (!avoided || r != FOUND_PATH || fabs(pool.summaryOut_map->cost - cost) > 1e-6)
+    {
+        std::cout << "*******************************************" << std::endl;
+        std::cout << "FAIL: Query after updateGrid DOES NOT match" << std::endl;
+        std::cout << "*******************************************" << std::endl;
+        return 4;
+    }
+
+    return 0;
+}
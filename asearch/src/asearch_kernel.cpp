@@ -5,506 +5,2151 @@
 #include "asearch_kernel.h"
 #include <stdio.h>
 
-extern "C"
+// Row and column step of each direction, indexed by direction. The
+// straight directions come first, so a CONN-connected search walks the
+// first CONN entries.
+constexpr int dirRow[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+constexpr int dirCol[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+constexpr int dirReverse[8] = { DIR_S, DIR_N, DIR_W, DIR_E, DIR_SW, DIR_SE, DIR_NW, DIR_NE };
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void searchCore(unsigned int gridIn[], int rows, int cols, Pair src, Pair dest, int search, int mode, result* res, pathSummary* summary, Pair pathOut[], cell cellOut[])
+{
+    DEBUG_LOG(1, "Pre-Check\n");
+
+    // Anything past this point indexes the on-chip arrays with the grid
+    // size, so this has to bail out early.
+    if (rows < 1 || rows > R || cols < 1 || cols > C)
+    {
+        setResult(res, summary, INVALID_GRID_SIZE);
+        return;
+    }
+
+    unsigned int grid[R][GRID_WORDS(C)];
+#pragma HLS ARRAY_PARTITION variable=grid cyclic factor=3 dim=1
+    loadGrid(gridIn, rows, cols, grid);
+
+    searchGrid<R, C, CONN, cost_t, OPEN>(grid, rows, cols, src, dest, search, mode, res, summary, pathOut, rows * cols, cellOut);
+}
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void batchCore(unsigned int gridIn[], int rows, int cols, int count, query queries[], int mode, queryResult results[], Pair pathOut[], int pathCapacity)
 {
-    void asearch(int gridIn[], Pair src, Pair dest, result* res, cell cellOut[])
+    if (rows < 1 || rows > R || cols < 1 || cols > C)
     {
-        int grid[ROW][COL];
-        for (int x = 0; x < ROW; x++)
+        for (int q = 0; q < count; q++)
         {
-            for (int y = 0; y < COL; y++)
-            {
-                grid[x][y] = gridIn[x * COL + y];
-            }
+            queryResult out;
+            setResult(&out.r, &out.summary, INVALID_GRID_SIZE);
+            out.offset = 0;
+            results[q] = out;
         }
+        return;
+    }
+
+    int pathMode = mode == OUTPUT_PATH ? OUTPUT_PATH : OUTPUT_COST;
+    batchDataflow<R, C, CONN, cost_t, OPEN>(gridIn, rows, cols, count, queries, pathMode, results, pathOut, pathCapacity);
+}
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void batchDataflow(unsigned int gridIn[], int rows, int cols, int count, query queries[], int mode, queryResult results[], Pair pathOut[], int pathCapacity)
+{
+    // Reading query n + 1 and writing back query n - 1 overlap with the
+    // search of query n, so once the pipeline fills a query costs only its
+    // search.
+#pragma HLS DATAFLOW
+    hls::stream<query> queryStream;
+    hls::stream<queryResult> resultStream;
+    hls::stream<Pair> pathStream;
+#pragma HLS STREAM variable=queryStream depth=4
+#pragma HLS STREAM variable=resultStream depth=4
+#pragma HLS STREAM variable=pathStream depth=R*C
+
+    loadQueries(count, queries, queryStream);
+    searchQueries<R, C, CONN, cost_t, OPEN>(gridIn, rows, cols, count, mode, queryStream, resultStream, pathStream);
+    storeResults(count, mode, resultStream, pathStream, results, pathOut, pathCapacity);
+}
+
+void loadQueries(int count, query queries[], hls::stream<query>& queryStream)
+{
+    for (int q = 0; q < count; q++)
+    {
+#pragma HLS PIPELINE II=1
+        queryStream.write(queries[q]);
+    }
+}
 
-        result r = PATH_NOT_FOUND;
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void searchQueries(unsigned int gridIn[], int rows, int cols, int count, int mode, hls::stream<query>& queryStream, hls::stream<queryResult>& resultStream, hls::stream<Pair>& pathStream)
+{
+    // The grid is read once and shared by every query in the batch.
+    unsigned int grid[R][GRID_WORDS(C)];
+#pragma HLS ARRAY_PARTITION variable=grid cyclic factor=3 dim=1
+    loadGrid(gridIn, rows, cols, grid);
 
-        printf("Pre-Check\n");
+    static Pair path[R * C];
+    for (int q = 0; q < count; q++)
+    {
+        query in = queryStream.read();
+        queryResult out;
+        searchGrid<R, C, CONN, cost_t, OPEN>(grid, rows, cols, in.src, in.dest, in.search, mode, &out.r, &out.summary, path, rows * cols, 0);
+        resultStream.write(out);
 
-        if (!isValid(src.first, src.second))
+        if (mode == OUTPUT_PATH && out.r == FOUND_PATH)
         {
-            r = INVALID_SOURCE;
+            for (int k = 0; k < out.summary.length; k++)
+            {
+#pragma HLS PIPELINE II=1
+                pathStream.write(path[k]);
+            }
         }
+    }
+}
 
-        if (!isValid(dest.first, dest.second))
+void storeResults(int count, int mode, hls::stream<queryResult>& resultStream, hls::stream<Pair>& pathStream, queryResult results[], Pair pathOut[], int pathCapacity)
+{
+    // Paths are packed back to back in query order; only found paths take
+    // up room, so offset is where the next one would start. A path that
+    // does not fit is drained and reported as PATH_OUTPUT_FULL.
+    int offset = 0;
+    for (int q = 0; q < count; q++)
+    {
+        queryResult out = resultStream.read();
+        out.offset = offset;
+
+        if (mode == OUTPUT_PATH && out.r == FOUND_PATH)
         {
-            r = INVALID_DESTINATION;
+            bool fits = out.summary.length <= pathCapacity - offset;
+            for (int k = 0; k < out.summary.length; k++)
+            {
+#pragma HLS PIPELINE II=1
+                Pair p = pathStream.read();
+                if (fits)
+                {
+                    pathOut[offset + k] = p;
+                }
+            }
+
+            if (fits)
+            {
+                offset += out.summary.length;
+            }
+            else
+            {
+                out.r = PATH_OUTPUT_FULL;
+            }
         }
 
-        if (!isUnBlocked(grid, src.first, src.second) ||
-            !isUnBlocked(grid, dest.first, dest.second))
+        results[q] = out;
+    }
+}
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void serveCore(unsigned int gridIn[], int rows, int cols, query ring[], volatile int doorbell[], queryResult results[], volatile int done[], Pair pathOut[], int ringSize, int mode)
+{
+    // Without a slot there is nowhere to take queries from.
+    if (ringSize < 1)
+    {
+        return;
+    }
+
+    bool sizeOk = rows >= 1 && rows <= R && cols >= 1 && cols <= C;
+    int pathMode = mode == OUTPUT_PATH ? OUTPUT_PATH : OUTPUT_COST;
+    int cells = rows * cols;
+
+    unsigned int grid[R][GRID_WORDS(C)];
+#pragma HLS ARRAY_PARTITION variable=grid cyclic factor=3 dim=1
+    if (sizeOk)
+    {
+        loadGrid(gridIn, rows, cols, grid);
+    }
+
+    // The host only ever adds to the tail and sets stop after its last
+    // tail write, so reading stop first means an empty ring with stop set
+    // stays empty.
+    int head = 0;
+    while (true)
+    {
+        int stop = doorbell[DOORBELL_STOP];
+        int tail = doorbell[DOORBELL_TAIL];
+        if (head == tail)
         {
-            r = PATH_IS_BLOCKED;
+            if (stop)
+            {
+                break;
+            }
+
+            continue;
         }
 
-        if (isDestination(src.first, src.second, dest))
+        int slot = head % ringSize;
+        query in = ring[slot];
+        queryResult out;
+        out.offset = slot * cells;
+        if (sizeOk)
+        {
+            searchGrid<R, C, CONN, cost_t, OPEN>(grid, rows, cols, in.src, in.dest, in.search, pathMode, &out.r, &out.summary, pathOut + out.offset, cells, 0);
+        }
+        else
         {
-            r = ALREADY_AT_DESTINATION;
+            setResult(&out.r, &out.summary, INVALID_GRID_SIZE);
         }
 
-        printf("Doing initialization\n");
+        results[slot] = out;
+        head++;
+        done[slot] = head;
+    }
+}
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void searchGrid(unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, int search, int mode, result* res, pathSummary* summary, Pair pathOut[], int pathCapacity, cell cellOut[])
+{
+    result r = PATH_NOT_FOUND;
+
+    // Anything past this point indexes the on-chip arrays with src and
+    // dest, so these have to bail out early.
+    if (!isValid(src.first, src.second, rows, cols))
+    {
+        setResult(res, summary, INVALID_SOURCE);
+        return;
+    }
+
+    if (!isValid(dest.first, dest.second, rows, cols))
+    {
+        setResult(res, summary, INVALID_DESTINATION);
+        return;
+    }
+
+    if (!isUnBlocked(grid, src.first, src.second) ||
+        !isUnBlocked(grid, dest.first, dest.second))
+    {
+        setResult(res, summary, PATH_IS_BLOCKED);
+        return;
+    }
+
+    // The search only ever checks neighbours against dest, so src == dest
+    // would otherwise re-parent the source and leave a cycle to walk.
+    if (isDestination(src.first, src.second, dest))
+    {
+        setResult(res, summary, ALREADY_AT_DESTINATION);
+        return;
+    }
+
+    DEBUG_LOG(1, "Doing initialization\n");
+    if (ASEARCH_DEBUG >= 2)
+    {
         printf("Grid:\n");
-        for (int x = 0; x < ROW; x++)
+        for (int x = 0; x < rows; x++)
         {
-            for (int y = 0; y < COL; y++)
+            for (int y = 0; y < cols; y++)
             {
-                printf("%d ", grid[x][y]);
+                printf("%d ", isUnBlocked(grid, x, y) ? 1 : 0);
             }
             printf("\n");
         }
+    }
 
-        // Create and populate closed list
-        bool closedList[ROW][COL];
-        memset(closedList, false, sizeof(closedList));
-
-        int i, j, newI, newJ;
+    // Kept across calls so a query only resets the cells it touches.
+    // back holds the dest side of a bidirectional search, and lm the
+    // landmark distances of the last grid SEARCH_ALT ran on.
+    static searchWorkspace<cost_t, R, C, OPEN> ws;
+    static searchWorkspace<cost_t, R, C, OPEN> back;
+    static landmarkTable<cost_t, R, C> lm;
+    // Neighbours span three rows and three columns, so a cyclic factor of
+    // 3 puts each one in its own bank.
+#pragma HLS ARRAY_PARTITION variable=ws.g cyclic factor=3 dim=1
+#pragma HLS ARRAY_PARTITION variable=ws.g cyclic factor=3 dim=2
+#pragma HLS ARRAY_PARTITION variable=ws.stamp cyclic factor=3 dim=1
+#pragma HLS ARRAY_PARTITION variable=ws.stamp cyclic factor=3 dim=2
+#pragma HLS ARRAY_PARTITION variable=ws.closed cyclic factor=3 dim=1
+#pragma HLS ARRAY_PARTITION variable=lm.dist complete dim=1
+#pragma HLS ARRAY_PARTITION variable=lm.dist cyclic factor=3 dim=2
+#pragma HLS ARRAY_PARTITION variable=lm.dist cyclic factor=3 dim=3
+#pragma HLS ARRAY_PARTITION variable=lm.openList complete dim=1
+    beginQuery(&ws);
+
+    bool openFull = false;
+    int expanded = 0;
+    bool foundDest;
+
+    // JPS pruning assumes diagonal moves, so 4-connected kernels run A*.
+    if (CONN == 8 && search == SEARCH_JPS)
+    {
+        foundDest = jpsSearch<R, C, cost_t, OPEN>(&ws, grid, rows, cols, src, dest, &openFull, &expanded);
+    }
+    else if (search == SEARCH_BIDIRECTIONAL)
+    {
+        beginQuery(&back);
+        foundDest = bidirectionalSearch<R, C, CONN, cost_t, OPEN>(&ws, &back, grid, rows, cols, src, dest, &openFull, &expanded);
+    }
+    else if (search == SEARCH_KBEST)
+    {
+        foundDest = kbestSearch<R, C, CONN, cost_t, OPEN>(&ws, grid, rows, cols, src, dest, &openFull, &expanded);
+    }
+    else if (search == SEARCH_ALT)
+    {
+        updateLandmarks<CONN>(&lm, grid, rows, cols);
+        foundDest = astarSearch<R, C, CONN, cost_t, OPEN>(&ws, &lm, grid, rows, cols, src, dest, &openFull, &expanded);
+    }
+    else
+    {
+        foundDest = astarSearch<R, C, CONN, cost_t, OPEN>(&ws, 0, grid, rows, cols, src, dest, &openFull, &expanded);
+    }
+    DEBUG_LOG(1, "Loop Done\n");
 
-        cell cellDetails[ROW][COL];
-        for (i = 0; i < ROW; i++)
+    if (ASEARCH_DEBUG >= 2)
+    {
+        printf("Closed Loop\n");
+        for (int x = 0; x < rows; x++)
         {
-            for (j = 0; j < COL; j++)
+            for (int y = 0; y < cols; y++)
             {
-                cellDetails[i][j] = cell();
-                cellDetails[i][j].f = FLT_MAX;
-                cellDetails[i][j].g = FLT_MAX;
-                cellDetails[i][j].h = FLT_MAX;
-                cellDetails[i][j].parent_i = -1;
-                cellDetails[i][j].parent_j = -1;
+                printf("closedList[%d][%d] = %d\n", x, y, testBit(ws.closed, x, y) ? 1 : 0);
             }
         }
+    }
+
+    if (mode == OUTPUT_DETAILS)
+    {
+        for (int x = 0; x < rows; x++)
+        {
+            for (int y = 0; y < cols; y++)
+            {
+                cell c;
+                c.parent_i = -1;
+                c.parent_j = -1;
+                c.f = FLT_MAX;
+                c.g = FLT_MAX;
+                c.h = FLT_MAX;
+                c.state = CELL_UNREACHED;
+
+                if (ws.stamp[x][y] == ws.generation && ws.g[x][y] != FLT_MAX)
+                {
+                    c.state = testBit(ws.closed, x, y) ? CELL_CLOSED : CELL_OPEN;
+                    c.parent_i = x;
+                    c.parent_j = y;
+                    if (!(x == src.first && y == src.second))
+                    {
+                        int dir = getParent(ws.parent, x, y);
+                        c.parent_i -= dirRow[dir];
+                        c.parent_j -= dirCol[dir];
+                    }
+
+                    c.g = ws.g[x][y];
+                    c.h = heuristicValue<CONN>(search == SEARCH_ALT ? &lm : 0, x, y, dest);
+                    c.f = c.g + c.h;
+                }
 
-        printf("Selecting first node\n");
-        // Set starting node
-        i = src.first;
-        j = src.second;
-        cellDetails[i][j].f = 0.0;
-        cellDetails[i][j].g = 0.0;
-        cellDetails[i][j].h = 0.0;
-        cellDetails[i][j].parent_i = i;
-        cellDetails[i][j].parent_j = j;
+                cellOut[x * cols + y] = c;
+            }
+        }
+    }
 
-        pPair openList[ROW * COL];
-        int index = 0;
-        init(openList);
+    r = foundDest ? FOUND_PATH : (openFull ? OPEN_LIST_FULL : PATH_NOT_FOUND);
+    setResult(res, summary, r);
+    summary->expanded = expanded;
 
-        addPPair(openList, make_pair(0.0, make_pair(i, j)));
-        bool foundDest = false;
+    // Walk the parent pointers here so path and cost modes only write
+    // back as much as the path is long.
+    if (foundDest)
+    {
+        cost_t cost = 0.0;
+        summary->length = buildPath<cost_t, R, C>(ws.parent, src, dest, pathOut, mode == OUTPUT_PATH, pathCapacity, &cost);
+        summary->cost = cost;
 
-        printf("Loop Starting\n");
-        while (!checkForEmpty(openList) && !foundDest)
+        if (mode == OUTPUT_PATH && summary->length > pathCapacity)
         {
-            getNext(openList, &index);
-            pPair p = openList[index];
+            *res = PATH_OUTPUT_FULL;
+        }
+    }
+}
 
-            removePPair(openList, index);
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+bool astarSearch(searchWorkspace<cost_t, R, C, OPEN>* ws, landmarkTable<cost_t, R, C>* lm, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, bool* openFull, int* expanded)
+{
+    int i, j, newI, newJ;
 
-            i = p.second.first;
-            j = p.second.second;
-            closedList[i][j] = true;
+    DEBUG_LOG(1, "Selecting first node\n");
+    // Set starting node
+    i = src.first;
+    j = src.second;
+    touch(ws, i, j);
+    ws->g[i][j] = 0.0;
 
-            /*
-            Cell-->Popped Cell (i,   j)
-            N -->  North       (i-1, j)
-            S -->  South       (i+1, j)
-            E -->  East        (i,   j+1)
-            W -->  West        (i,   j-1)
-            N.E--> North-East  (i-1, j+1)
-            N.W--> North-West  (i-1, j-1)
-            S.E--> South-East  (i+1, j+1)
-            S.W--> South-West  (i+1, j-1)
-            */
+    addPPair(&ws->openList, make_pair(cost_t(0.0), make_pair(i, j)));
+    bool foundDest = false;
 
-            double newG, newH, newF;
+    DEBUG_LOG(1, "Loop Starting\n");
+    while (!checkForEmpty(&ws->openList) && !foundDest && !*openFull)
+    {
+        pPair p = getNext(&ws->openList);
+        (*expanded)++;
 
-            // Check North
-            newI = i - 1;
-            newJ = j;
-            if (isValid(newI, newJ))
-            {
-                if (isDestination(newI, newJ, dest))
-                {
-                    cellDetails[newI][newJ].parent_i = i;
-                    cellDetails[newI][newJ].parent_j = j;
-                    foundDest = true;
-                    break;
-                }
-                else if (!closedList[newI][newJ] &&
-                    isUnBlocked(grid, newI, newJ))
-                {
-                    newG = cellDetails[i][j].g + 1.0;
-                    newH = calculateHValue(newI, newJ, dest);
-                    newF = newG + newH;
+        i = p.second.first;
+        j = p.second.second;
+        setBit(ws->closed, i, j);
 
-                    if (checkF(cellDetails, newI, newJ, newF))
-                    {
-                        addPPair(openList, make_pair(newF,
-                            make_pair(newI, newJ)));
-
-                        cellDetails[newI][newJ].f = newF;
-                        cellDetails[newI][newJ].g = newG;
-                        cellDetails[newI][newJ].h = newH;
-                        cellDetails[newI][newJ].parent_i = i;
-                        cellDetails[newI][newJ].parent_j = j;
-                    }
-                }
-            }
+        // dest is only done once it comes off the open list; when it is
+        // first reached, a cheaper way in may still be open.
+        if (isDestination(i, j, dest))
+        {
+            foundDest = true;
+            break;
+        }
 
-            // Check South
-            newI = i + 1;
-            newJ = j;
-            if (isValid(newI, newJ))
+        // All neighbours are evaluated side by side and only read the
+        // workspace. g and stamp are split three ways on both dimensions,
+        // so each of the nine cells around (i, j) is in its own bank. The
+        // closed and grid bits of a row sit in at most two words, which
+        // are read once per row. Cells from an older query read as
+        // unreached and are only reset below, when they are written.
+        cost_t g = ws->g[i][j];
+        unsigned int closedLo[3], closedHi[3], openLo[3], openHi[3];
+        readNeighbourWords(ws->closed, i, j, rows, cols, closedLo, closedHi);
+        readNeighbourWords(grid, i, j, rows, cols, openLo, openHi);
+
+        bool improves[8];
+        cost_t newG[8];
+        cost_t newF[8];
+        for (int dir = 0; dir < CONN; dir++)
+        {
+#pragma HLS UNROLL
+            newI = i + dirRow[dir];
+            newJ = j + dirCol[dir];
+            improves[dir] = false;
+            newG[dir] = g + (dir >= DIR_NE ? 1.414 : 1.0);
+            newF[dir] = newG[dir];
+
+            if (isValid(newI, newJ, rows, cols))
             {
-                if (isDestination(newI, newJ, dest))
+                bool fresh = ws->stamp[newI][newJ] == ws->generation;
+                bool closed = fresh && neighbourBit(closedLo, closedHi, dirRow[dir] + 1, j, newJ);
+                if (!closed && neighbourBit(openLo, openHi, dirRow[dir] + 1, j, newJ))
                 {
-                    cellDetails[newI][newJ].parent_i = i;
-                    cellDetails[newI][newJ].parent_j = j;
-                    foundDest = true;
-                    break;
+                    cost_t newH = heuristicValue<CONN>(lm, newI, newJ, dest);
+                    newF[dir] = newG[dir] + newH;
+                    improves[dir] = checkF(fresh ? ws->g[newI][newJ] : cost_t(FLT_MAX), newH, newF[dir]);
                 }
-                else if (!closedList[newI][newJ] &&
-                    isUnBlocked(grid, newI, newJ))
-                {
-                    newG = cellDetails[newI][newJ].g + 1.0;
-                    newH = calculateHValue(newI, newJ, dest);
-                    newF = newG + newH;
+            }
+        }
 
-                    if (checkF(cellDetails, newI, newJ, newF))
-                    {
-                        addPPair(openList, make_pair(newF,
-                            make_pair(newI, newJ)));
-                        cellDetails[newI][newJ].f = newF;
-                        cellDetails[newI][newJ].g = newG;
-                        cellDetails[newI][newJ].h = newH;
-                        cellDetails[newI][newJ].parent_i = i;
-                        cellDetails[newI][newJ].parent_j = j;
-                    }
-                }
+        for (int dir = 0; dir < CONN; dir++)
+        {
+            newI = i + dirRow[dir];
+            newJ = j + dirCol[dir];
+            if (!improves[dir])
+            {
+                continue;
             }
 
-            // Check East
-            newI = i;
-            newJ = j + 1;
-            if (isValid(newI, newJ))
+            touch(ws, newI, newJ);
+            if (!addPPair(&ws->openList, make_pair(newF[dir], make_pair(newI, newJ))))
             {
-                if (isDestination(newI, newJ, dest))
-                {
-                    cellDetails[newI][newJ].parent_i = i;
-                    cellDetails[newI][newJ].parent_j = j;
-                    foundDest = true;
-                    break;
-                }
-                else if (!closedList[newI][newJ] &&
-                    isUnBlocked(grid, newI, newJ))
-                {
-                    newG = cellDetails[i][j].g + 1.0;
-                    newH = calculateHValue(newI, newJ, dest);
-                    newF = newG + newH;
+                *openFull = true;
+                break;
+            }
 
-                    if (checkF(cellDetails, newI, newJ, newF))
-                    {
-                        addPPair(openList, make_pair(newF, make_pair(newI, newJ)));
+            ws->g[newI][newJ] = newG[dir];
+            setParent(ws->parent, newI, newJ, dir);
+        }
+    }
 
-                        cellDetails[newI][newJ].f = newF;
-                        cellDetails[newI][newJ].g = newG;
-                        cellDetails[newI][newJ].h = newH;
-                        cellDetails[newI][newJ].parent_i = i;
-                        cellDetails[newI][newJ].parent_j = j;
-                    }
-                }
-            }
+    return foundDest;
+}
 
-            // Check West
-            newI = i;
-            newJ = j - 1;
-            if (isValid(newI, newJ))
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+bool kbestSearch(searchWorkspace<cost_t, R, C, OPEN>* ws, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, bool* openFull, int* expanded)
+{
+    touch(ws, src.first, src.second);
+    ws->g[src.first][src.second] = 0.0;
+    addPPair(&ws->openList, make_pair(calculateHValue<cost_t, CONN>(src.first, src.second, dest), src));
+
+    // best is the cheapest path to dest so far. Lanes can expand a cell
+    // before its cheapest g is known, so dest only ends the search once no
+    // open cell can lead to a path cheaper than best / KBEST_BOUND.
+    touch(ws, dest.first, dest.second);
+    bool done = false;
+    while (!checkForEmpty(&ws->openList) && !done && !*openFull)
+    {
+        int lanes = 0;
+        Pair lane[KBEST_LANES];
+        for (int k = 0; k < KBEST_LANES && !checkForEmpty(&ws->openList); k++)
+        {
+            if (ws->openList.nodes[0].first * KBEST_BOUND >= ws->g[dest.first][dest.second])
             {
-                if (isDestination(newI, newJ, dest))
-                {
-                    cellDetails[newI][newJ].parent_i = i;
-                    cellDetails[newI][newJ].parent_j = j;
-                    foundDest = true;
-                    break;
-                }
-                else if (!closedList[newI][newJ] &&
-                    isUnBlocked(grid, newI, newJ))
-                {
-                    newG = cellDetails[i][j].g + 1.0;
-                    newH = calculateHValue(newI, newJ, dest);
-                    newF = newG + newH;
+                done = lanes == 0;
+                break;
+            }
 
-                    if (checkF(cellDetails, newI, newJ, newF))
-                    {
-                        addPPair(openList, make_pair(newF, make_pair(newI, newJ)));
+            lane[lanes] = getNext(&ws->openList).second;
+            setBit(ws->closed, lane[lanes].first, lane[lanes].second);
+            lanes++;
+        }
 
-                        cellDetails[newI][newJ].f = newF;
-                        cellDetails[newI][newJ].g = newG;
-                        cellDetails[newI][newJ].h = newH;
-                        cellDetails[newI][newJ].parent_i = i;
-                        cellDetails[newI][newJ].parent_j = j;
-                    }
-                }
+        *expanded += lanes;
+
+        // Every lane looks at all of its neighbours at once.
+        bool valid[KBEST_LANES][8];
+        cost_t newG[KBEST_LANES][8];
+        for (int k = 0; k < KBEST_LANES; k++)
+        {
+#pragma HLS UNROLL
+            for (int dir = 0; dir < CONN; dir++)
+            {
+#pragma HLS UNROLL
+                Pair cell = k < lanes ? lane[k] : src;
+                valid[k][dir] = k < lanes && isPassable(grid, rows, cols, dest, cell.first + dirRow[dir], cell.second + dirCol[dir]);
+                newG[k][dir] = ws->g[cell.first][cell.second] + (dir >= DIR_NE ? 1.414 : 1.0);
             }
+        }
 
-            // Check North-East
-            newI = i - 1;
-            newJ = j + 1;
-            if (isValid(newI, newJ))
+        // Lanes reaching the same cell merge here: the lowest g wins. A
+        // closed cell that gets a lower g is opened again.
+        for (int k = 0; k < lanes && !*openFull; k++)
+        {
+            for (int dir = 0; dir < CONN; dir++)
             {
-                if (isDestination(newI, newJ, dest))
+                int newI = lane[k].first + dirRow[dir];
+                int newJ = lane[k].second + dirCol[dir];
+                if (!valid[k][dir])
                 {
-                    cellDetails[newI][newJ].parent_i = i;
-                    cellDetails[newI][newJ].parent_j = j;
-                    foundDest = true;
-                    break;
+                    continue;
                 }
-                else if (!closedList[newI][newJ] &&
-                    isUnBlocked(grid, newI, newJ))
-                {
-                    newG = cellDetails[newI][newJ].g + 1.414;
-                    newH = calculateHValue(newI, newJ, dest);
-                    newF = newG + newH;
-
-                    if (checkF(cellDetails, newI, newJ, newF))
-                    {
-                        addPPair(openList, make_pair(newF, make_pair(newI, newJ)));
 
-                        cellDetails[newI][newJ].f = newF;
-                        cellDetails[newI][newJ].g = newG;
-                        cellDetails[newI][newJ].h = newH;
-                        cellDetails[newI][newJ].parent_i = i;
-                        cellDetails[newI][newJ].parent_j = j;
-                    }
+                touch(ws, newI, newJ);
+                if (newG[k][dir] >= ws->g[newI][newJ])
+                {
+                    continue;
                 }
-            }
 
-            // Check North-West
-            newI = i - 1;
-            newJ = j - 1;
-            if (isValid(newI, newJ))
-            {
+                ws->g[newI][newJ] = newG[k][dir];
+                setParent(ws->parent, newI, newJ, dir);
                 if (isDestination(newI, newJ, dest))
                 {
-                    cellDetails[newI][newJ].parent_i = i;
-                    cellDetails[newI][newJ].parent_j = j;
-                    foundDest = true;
-                    break;
-                }
-                else if (!closedList[newI][newJ] &&
-                    isUnBlocked(grid, newI, newJ))
-                {
-                    newG = cellDetails[newI][newJ].g + 1.414;
-                    newH = calculateHValue(newI, newJ, dest);
-                    newF = newG + newH;
-
-                    if (checkF(cellDetails, newI, newJ, newF))
-                    {
-                        addPPair(openList, make_pair(newF, make_pair(newI, newJ)));
-
-                        cellDetails[newI][newJ].f = newF;
-                        cellDetails[newI][newJ].g = newG;
-                        cellDetails[newI][newJ].h = newH;
-                        cellDetails[newI][newJ].parent_i = i;
-                        cellDetails[newI][newJ].parent_j = j;
-                    }
+                    continue;
                 }
-            }
 
-            // Check South-East
-            newI = i + 1;
-            newJ = j + 1;
-            if (isValid(newI, newJ))
-            {
-                if (isDestination(newI, newJ, dest))
+                clearBit(ws->closed, newI, newJ);
+                if (!addPPair(&ws->openList, make_pair(newG[k][dir] + calculateHValue<cost_t, CONN>(newI, newJ, dest), make_pair(newI, newJ))))
                 {
-                    cellDetails[newI][newJ].parent_i = i;
-                    cellDetails[newI][newJ].parent_j = j;
-                    foundDest = true;
+                    *openFull = true;
                     break;
                 }
-                else if (!closedList[newI][newJ] &&
-                    isUnBlocked(grid, newI, newJ))
-                {
-                    newG = cellDetails[newI][newJ].g + 1.414;
-                    newH = calculateHValue(newI, newJ, dest);
-                    newF = newG + newH;
+            }
+        }
+    }
 
-                    if (checkF(cellDetails, newI, newJ, newF))
-                    {
-                        addPPair(openList, make_pair(newF, make_pair(newI, newJ)));
+    return !*openFull && ws->g[dest.first][dest.second] != FLT_MAX;
+}
 
-                        cellDetails[newI][newJ].f = newF;
-                        cellDetails[newI][newJ].g = newG;
-                        cellDetails[newI][newJ].h = newH;
-                        cellDetails[newI][newJ].parent_i = i;
-                        cellDetails[newI][newJ].parent_j = j;
-                    }
-                }
-            }
+template <int R, int C, typename cost_t, int OPEN>
+bool jpsSearch(searchWorkspace<cost_t, R, C, OPEN>* ws, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, bool* openFull, int* expanded)
+{
+    touch(ws, src.first, src.second);
+    ws->g[src.first][src.second] = 0.0;
+    addPPair(&ws->openList, make_pair(cost_t(0.0), src));
 
-            // Check South-West
-            newI = i + 1;
-            newJ = j - 1;
-            if (isValid(newI, newJ))
-            {
-                if (isDestination(newI, newJ, dest))
-                {
-                    cellDetails[newI][newJ].parent_i = i;
-                    cellDetails[newI][newJ].parent_j = j;
-                    foundDest = true;
-                    break;
-                }
-                else if (!closedList[newI][newJ] &&
-                    isUnBlocked(grid, newI, newJ))
-                {
-                    newG = cellDetails[newI][newJ].g + 1.414;
-                    newH = calculateHValue(newI, newJ, dest);
-                    newF = newG + newH;
+    while (!checkForEmpty(&ws->openList))
+    {
+        pair<cost_t, Pair> p = getNext(&ws->openList);
+        (*expanded)++;
 
-                    if (checkF(cellDetails, newI, newJ, newF))
-                    {
-                        addPPair(openList, make_pair(newF, make_pair(newI, newJ)));
+        int i = p.second.first;
+        int j = p.second.second;
+        setBit(ws->closed, i, j);
 
-                        cellDetails[newI][newJ].f = newF;
-                        cellDetails[newI][newJ].g = newG;
-                        cellDetails[newI][newJ].h = newH;
-                        cellDetails[newI][newJ].parent_i = i;
-                        cellDetails[newI][newJ].parent_j = j;
-                    }
-                }
-            }
+        // As in A*, dest only has its final cost once it is popped; a jump
+        // point can still be reached more cheaply after it is generated.
+        if (isDestination(i, j, dest))
+        {
+            return true;
         }
-        printf("Loop Done\n");
 
-        printf("Closed Loop\n");
-        for (int x = 0; x < ROW; x++)
+        int from = (i == src.first && j == src.second) ? -1 : getParent(ws->parent, i, j);
+
+        for (int dir = 0; dir < 8; dir++)
         {
-            for (int y = 0; y < COL; y++)
+            int jumpI, jumpJ;
+            if (!isJumpDirection(grid, rows, cols, dest, i, j, from, dir) ||
+                !jump(grid, rows, cols, dest, i, j, dir, &jumpI, &jumpJ))
             {
-                printf("closedList[%d][%d] = %d\n", x, y, closedList[x][y]);
+                continue;
             }
-        }
 
-        for (int x = 0; x < ROW; x++)
-        {
-            for (int y = 0; y < COL; y++)
+            touch(ws, jumpI, jumpJ);
+            if (testBit(ws->closed, jumpI, jumpJ))
             {
-                cellOut[x * COL + y] = cellDetails[x][y];
+                continue;
             }
-        }
 
-        r = foundDest ? FOUND_PATH : PATH_NOT_FOUND;
-        *res = r;
-    }
-}
+            // Relax the cells jumped over too, so the parent directions
+            // still spell out the path one step at a time for buildPath.
+            cost_t step = dir >= DIR_NE ? 1.414 : 1.0;
+            cost_t newG = ws->g[i][j];
+            int row = i;
+            int col = j;
+            do
+            {
+                row += dirRow[dir];
+                col += dirCol[dir];
+                newG += step;
+                touch(ws, row, col);
 
-bool isValid(int row, int col)
-{
-    return (row >= 0) &&
-        (row < ROW) &&
-        (col >= 0) &&
-        (col < COL);
-}
+                if (newG < ws->g[row][col])
+                {
+                    ws->g[row][col] = newG;
+                    setParent(ws->parent, row, col, dir);
 
-bool isUnBlocked(int grid[][COL], int row, int col)
-{
-    return grid[row][col] == 1;
-}
+                    bool queued = ws->openList.pos[row][col] != -1;
+                    if ((queued || (row == jumpI && col == jumpJ)) &&
+                        !addPPair(&ws->openList, make_pair(newG + calculateHValue<cost_t, 8>(row, col, dest), make_pair(row, col))))
+                    {
+                        *openFull = true;
+                        return false;
+                    }
+                }
+            } while (!(row == jumpI && col == jumpJ));
+        }
+    }
 
-bool isDestination(int row, int col, Pair dest)
-{
-    return row == dest.first && col == dest.second;
+    return false;
 }
 
-double calculateHValue(int row, int col, Pair dest)
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+bool bidirectionalSearch(searchWorkspace<cost_t, R, C, OPEN>* ws, searchWorkspace<cost_t, R, C, OPEN>* back, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, bool* openFull, int* expanded)
 {
-    double xDiff = row - dest.first;
-    double yDiff = col - dest.second;
-
-    double sum = (xDiff * xDiff) + (yDiff * yDiff);
-
-    return sqrt(sum);
-}
+    touch(ws, src.first, src.second);
+    ws->g[src.first][src.second] = 0.0;
+    addPPair(&ws->openList, make_pair(calculateHValue<cost_t, CONN>(src.first, src.second, dest) / 2, src));
+
+    touch(back, dest.first, dest.second);
+    back->g[dest.first][dest.second] = 0.0;
+    addPPair(&back->openList, make_pair(calculateHValue<cost_t, CONN>(dest.first, dest.second, src) / 2, dest));
+
+    cost_t best = FLT_MAX;
+    Pair meet = src;
+
+    // Both sides are keyed on g plus half the difference of the two
+    // heuristics, which is the same potential seen from either end. Their
+    // two smallest keys then bound any path not yet found from below, so
+    // the search can stop as soon as they reach best.
+    while (!checkForEmpty(&ws->openList) && !checkForEmpty(&back->openList) &&
+        ws->openList.nodes[0].first + back->openList.nodes[0].first < best)
+    {
+        (*expanded)++;
 
-void readGrid(const char* file, int grid[][COL])
-{
-    FILE* pFile = fopen(file, "r");
+        // Grow the smaller frontier.
+        bool added = ws->openList.size <= back->openList.size ?
+            expandSide<R, C, CONN>(ws, back, grid, rows, cols, src, dest, &best, &meet) :
+            expandSide<R, C, CONN>(back, ws, grid, rows, cols, dest, src, &best, &meet);
 
-    int val;
-    for (int i = 0; i < ROW; i++)
-    {
-        for (int j = 0; j < COL; j++)
+        if (!added)
         {
-            fscanf(pFile, "%i", &val);
-            grid[i][j] = val;
+            *openFull = true;
+            return false;
         }
     }
 
-    fclose(pFile);
-}
-
-bool checkF(cell cellDetails[][COL], int i, int j, double f)
-{
-    return cellDetails[i][j].f == FLT_MAX || cellDetails[i][j].f > f;
-}
+    if (best == FLT_MAX)
+    {
+        return false;
+    }
 
-void init(pPair* list)
-{
-    for (int i = 0; i < COL * ROW; i++)
+    // Turn the dest side around onto the forward parents so buildPath and
+    // the details output see one path from src to dest.
+    int row = meet.first;
+    int col = meet.second;
+    while (!isDestination(row, col, dest))
     {
-        list[i] = make_pair(-1, make_pair(-1, -1));
+        int dir = getParent(back->parent, row, col);
+        cost_t newG = ws->g[row][col] + (dir >= DIR_NE ? 1.414 : 1.0);
+
+        row -= dirRow[dir];
+        col -= dirCol[dir];
+        touch(ws, row, col);
+        ws->g[row][col] = newG;
+        setParent(ws->parent, row, col, dirReverse[dir]);
     }
+
+    return true;
 }
 
-bool checkForEmpty(pPair* list)
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+bool expandSide(searchWorkspace<cost_t, R, C, OPEN>* ws, searchWorkspace<cost_t, R, C, OPEN>* other, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair start, Pair goal, cost_t* best, Pair* meet)
 {
-    bool empty = true;
-
-    for (int i = 0; empty && i < COL * ROW; i++)
+    pair<cost_t, Pair> p = getNext(&ws->openList);
+    int i = p.second.first;
+    int j = p.second.second;
+    setBit(ws->closed, i, j);
+
+    // Moves are symmetric, so the dest side walks the same edges backwards
+    // and may only step onto blocked cells when they are its own goal, src.
+    for (int dir = 0; dir < CONN; dir++)
     {
-        if (list[i].first != -1)
+        int newI = i + dirRow[dir];
+        int newJ = j + dirCol[dir];
+        if (!isPassable(grid, rows, cols, goal, newI, newJ))
         {
-            empty = false;
-            break;
+            continue;
         }
-    }
 
-    return empty;
-}
+        touch(ws, newI, newJ);
+        cost_t newG = ws->g[i][j] + (dir >= DIR_NE ? 1.414 : 1.0);
+        if (testBit(ws->closed, newI, newJ) || newG >= ws->g[newI][newJ])
+        {
+            continue;
+        }
 
-void getNext(pPair* list, int* index)
-{
-    pPair rtnVal = make_pair(-1, make_pair(-1, -1));
-    *index = 0;
+        ws->g[newI][newJ] = newG;
+        setParent(ws->parent, newI, newJ, dir);
 
-    for (int i = 0; i < COL * ROW; i++)
-    {
-        if (rtnVal.first == -1 || // If no valid value has been grabbed
-            (rtnVal.first > list[i].first && list[i].first != -1)// Or the list's value is an easier distance
-            )
+        touch(other, newI, newJ);
+        if (other->g[newI][newJ] != FLT_MAX && newG + other->g[newI][newJ] < *best)
+        {
+            *best = newG + other->g[newI][newJ];
+            *meet = make_pair(newI, newJ);
+        }
+
+        // A cell that cannot lead to anything cheaper than best is not
+        // worth queueing.
+        cost_t toGoal = calculateHValue<cost_t, CONN>(newI, newJ, goal);
+        cost_t key = newG + (toGoal - calculateHValue<cost_t, CONN>(newI, newJ, start)) / 2;
+        if (newG + toGoal < *best && !addPPair(&ws->openList, make_pair(key, make_pair(newI, newJ))))
         {
-            *index = i;
-            rtnVal = list[i];
+            return false;
         }
     }
+
+    return true;
 }
 
-void addPPair(pPair* list, const pPair& pair)
+template <int CONN, typename cost_t, int R, int C>
+void updateLandmarks(landmarkTable<cost_t, R, C>* lm, unsigned int grid[][GRID_WORDS(C)], int rows, int cols)
 {
-    for (int i = 0; i < COL * ROW; i++)
+    // Comparing the grid costs far less than one distance table, so the
+    // tables are only rebuilt for a new map.
+    bool same = lm->ready && rows == lm->rows && cols == lm->cols;
+    for (int x = 0; same && x < rows; x++)
     {
-        if (list[i].first == -1)
+        for (int w = 0; w < GRID_WORDS(cols); w++)
         {
-            list[i] = pair;
-            break;
+            same &= grid[x][w] == lm->grid[x][w];
         }
     }
-}
 
-void removePPair(pPair* list, int index)
-{
-    if (0 <= index && index < COL * ROW)
+    if (same)
     {
-        list[index] = make_pair(-1, make_pair(-1, -1));
+        return;
     }
+
+    for (int x = 0; x < rows; x++)
+    {
+        for (int w = 0; w < GRID_WORDS(cols); w++)
+        {
+            lm->grid[x][w] = grid[x][w];
+        }
+    }
+
+    lm->rows = rows;
+    lm->cols = cols;
+    lm->ready = true;
+
+    // Landmarks spread evenly around the border bound the most queries;
+    // each is the open cell nearest its spot on the border.
+    int perimeter = 2 * (rows - 1) + 2 * (cols - 1);
+    for (int k = 0; k < ALT_LANDMARKS; k++)
+    {
+#pragma HLS UNROLL
+        int t = perimeter * k / ALT_LANDMARKS;
+        Pair spot;
+        if (t < cols - 1)
+        {
+            spot = make_pair(0, t);
+        }
+        else if (t < cols - 1 + rows - 1)
+        {
+            spot = make_pair(t - (cols - 1), cols - 1);
+        }
+        else if (t < 2 * (cols - 1) + rows - 1)
+        {
+            spot = make_pair(rows - 1, cols - 1 - (t - (cols - 1 + rows - 1)));
+        }
+        else
+        {
+            spot = make_pair(rows - 1 - (t - (2 * (cols - 1) + rows - 1)), 0);
+        }
+
+        Pair landmark = make_pair(-1, -1);
+        int best = 0;
+        for (int x = 0; x < rows; x++)
+        {
+            for (int y = 0; y < cols; y++)
+            {
+                int d = (x - spot.first) * (x - spot.first) + (y - spot.second) * (y - spot.second);
+                if (isUnBlocked(grid, x, y) && (landmark.first == -1 || d < best))
+                {
+                    landmark = make_pair(x, y);
+                    best = d;
+                }
+            }
+        }
+
+        landmarkDistances<CONN>(lm, k, landmark);
+    }
+}
+
+template <int CONN, typename cost_t, int R, int C>
+void landmarkDistances(landmarkTable<cost_t, R, C>* lm, int k, Pair from)
+{
+    for (int x = 0; x < lm->rows; x++)
+    {
+        for (int y = 0; y < lm->cols; y++)
+        {
+            lm->dist[k][x][y] = FLT_MAX;
+            lm->openList[k].pos[x][y] = -1;
+        }
+    }
+
+    lm->openList[k].size = 0;
+    if (from.first == -1)
+    {
+        return;
+    }
+
+    lm->dist[k][from.first][from.second] = 0.0;
+    addPPair(&lm->openList[k], make_pair((cost_t)0.0, from));
+
+    // Moves cost the same both ways, so distances from the landmark are
+    // also distances to it.
+    while (!checkForEmpty(&lm->openList[k]))
+    {
+        pair<cost_t, Pair> p = getNext(&lm->openList[k]);
+        int i = p.second.first;
+        int j = p.second.second;
+
+        for (int dir = 0; dir < CONN; dir++)
+        {
+            int newI = i + dirRow[dir];
+            int newJ = j + dirCol[dir];
+            if (!isValid(newI, newJ, lm->rows, lm->cols) || !isUnBlocked(lm->grid, newI, newJ))
+            {
+                continue;
+            }
+
+            cost_t newG = lm->dist[k][i][j] + (dir >= DIR_NE ? 1.414 : 1.0);
+            if (newG < lm->dist[k][newI][newJ])
+            {
+                lm->dist[k][newI][newJ] = newG;
+                addPPair(&lm->openList[k], make_pair(newG, make_pair(newI, newJ)));
+            }
+        }
+    }
+}
+
+template <int CONN, typename cost_t, int R, int C>
+cost_t heuristicValue(landmarkTable<cost_t, R, C>* lm, int row, int col, Pair dest)
+{
+    cost_t h = calculateHValue<cost_t, CONN>(row, col, dest);
+    if (lm == 0)
+    {
+        return h;
+    }
+
+    // By the triangle inequality the cost to dest is at least the
+    // difference of their distances to any landmark. Cells a landmark
+    // cannot reach give no bound.
+    for (int k = 0; k < ALT_LANDMARKS; k++)
+    {
+        cost_t a = lm->dist[k][row][col];
+        cost_t b = lm->dist[k][dest.first][dest.second];
+        if (a != FLT_MAX && b != FLT_MAX)
+        {
+            cost_t d = a > b ? a - b : b - a;
+            h = d > h ? d : h;
+        }
+    }
+
+    return h;
+}
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void replanCore(unsigned int gridIn[], int rows, int cols, Pair src, Pair dest, int reset, cellChange changes[], int changeCount, int mode, result* res, pathSummary* summary, Pair pathOut[])
+{
+    if (rows < 1 || rows > R || cols < 1 || cols > C)
+    {
+        setResult(res, summary, INVALID_GRID_SIZE);
+        return;
+    }
+
+    if (!isValid(src.first, src.second, rows, cols))
+    {
+        setResult(res, summary, INVALID_SOURCE);
+        return;
+    }
+
+    if (!isValid(dest.first, dest.second, rows, cols))
+    {
+        setResult(res, summary, INVALID_DESTINATION);
+        return;
+    }
+
+    static replanState<cost_t, R, C, OPEN> st;
+
+    if (reset || !st.ready || rows != st.rows || cols != st.cols || dest != st.dest)
+    {
+        loadGrid(gridIn, rows, cols, st.grid);
+        for (int x = 0; x < rows; x++)
+        {
+            for (int y = 0; y < cols; y++)
+            {
+                st.g[x][y] = FLT_MAX;
+                st.rhs[x][y] = FLT_MAX;
+                st.openList.pos[x][y] = -1;
+            }
+        }
+
+        st.openList.size = 0;
+        st.rows = rows;
+        st.cols = cols;
+        st.dest = dest;
+        st.last = src;
+        st.km = 0.0;
+        st.ready = true;
+
+        st.rhs[dest.first][dest.second] = 0.0;
+        addPPair(&st.openList, make_pair(calculateKey<CONN>(&st, src, dest.first, dest.second), dest));
+    }
+    else
+    {
+        // Keys queued before the robot moved are off by at most the
+        // distance it moved; folding that into km keeps them lower bounds.
+        st.km += replanHValue<CONN, cost_t>(st.last.first, st.last.second, src);
+        st.last = src;
+
+        for (int c = 0; c < changeCount; c++)
+        {
+            cellChange change = changes[c];
+            int row = change.cell.first;
+            int col = change.cell.second;
+            if (!isValid(row, col, rows, cols))
+            {
+                continue;
+            }
+
+            if (change.unblocked)
+            {
+                setBit(st.grid, row, col);
+            }
+            else
+            {
+                clearBit(st.grid, row, col);
+            }
+
+            // Only moves into the cell change cost, so only the cells
+            // around it can have a different rhs.
+            for (int dir = 0; dir < CONN; dir++)
+            {
+                int newI = row + dirRow[dir];
+                int newJ = col + dirCol[dir];
+                if (isValid(newI, newJ, rows, cols))
+                {
+                    updateVertex<CONN>(&st, src, newI, newJ);
+                }
+            }
+        }
+    }
+
+    if (!isUnBlocked(st.grid, src.first, src.second) ||
+        !isUnBlocked(st.grid, dest.first, dest.second))
+    {
+        setResult(res, summary, PATH_IS_BLOCKED);
+        return;
+    }
+
+    if (isDestination(src.first, src.second, dest))
+    {
+        setResult(res, summary, ALREADY_AT_DESTINATION);
+        return;
+    }
+
+    int expanded = 0;
+    bool openFull = !computeShortestPath<CONN>(&st, src, &expanded);
+
+    result r = openFull ? OPEN_LIST_FULL : PATH_NOT_FOUND;
+    int length = 0;
+    cost_t cost = 0.0;
+    if (!openFull && st.rhs[src.first][src.second] != FLT_MAX)
+    {
+        // The search can stop with src still queued, so its cost is in
+        // rhs. The path follows the cheapest step plus g from each cell.
+        Pair cur = src;
+        length = 1;
+        if (mode == OUTPUT_PATH)
+        {
+            pathOut[0] = cur;
+        }
+
+        while (!isDestination(cur.first, cur.second, dest) && length < rows * cols)
+        {
+            int bestDir = -1;
+            cost_t best = FLT_MAX;
+            for (int dir = 0; dir < CONN; dir++)
+            {
+                int newI = cur.first + dirRow[dir];
+                int newJ = cur.second + dirCol[dir];
+                if (isPassable(st.grid, rows, cols, dest, newI, newJ) && st.g[newI][newJ] != FLT_MAX &&
+                    st.g[newI][newJ] + (dir >= DIR_NE ? 1.414 : 1.0) < best)
+                {
+                    best = st.g[newI][newJ] + (dir >= DIR_NE ? 1.414 : 1.0);
+                    bestDir = dir;
+                }
+            }
+
+            if (bestDir == -1)
+            {
+                break;
+            }
+
+            cur = make_pair(cur.first + dirRow[bestDir], cur.second + dirCol[bestDir]);
+            cost += bestDir >= DIR_NE ? 1.414 : 1.0;
+            if (mode == OUTPUT_PATH)
+            {
+                pathOut[length] = cur;
+            }
+            length++;
+        }
+
+        if (isDestination(cur.first, cur.second, dest))
+        {
+            r = FOUND_PATH;
+        }
+    }
+
+    setResult(res, summary, r);
+    summary->expanded = expanded;
+    if (r == FOUND_PATH)
+    {
+        summary->length = length;
+        summary->cost = cost;
+    }
+}
+
+template <int CONN, typename cost_t, int R, int C, int OPEN>
+bool computeShortestPath(replanState<cost_t, R, C, OPEN>* st, Pair start, int* expanded)
+{
+    int i = start.first;
+    int j = start.second;
+
+    while (!checkForEmpty(&st->openList) &&
+        (st->openList.nodes[0].first < calculateKey<CONN>(st, start, i, j) || st->rhs[i][j] > st->g[i][j]))
+    {
+        pair<lpaKey<cost_t>, Pair> top = st->openList.nodes[0];
+        int row = top.second.first;
+        int col = top.second.second;
+        lpaKey<cost_t> key = calculateKey<CONN>(st, start, row, col);
+        (*expanded)++;
+
+        if (top.first < key)
+        {
+            // Queued before the robot moved, so the key is stale.
+            removePPair(&st->openList, top.second);
+            addPPair(&st->openList, make_pair(key, top.second));
+            continue;
+        }
+
+        getNext(&st->openList);
+        if (st->g[row][col] > st->rhs[row][col])
+        {
+            st->g[row][col] = st->rhs[row][col];
+        }
+        else
+        {
+            st->g[row][col] = FLT_MAX;
+            if (!updateVertex<CONN>(st, start, row, col))
+            {
+                return false;
+            }
+        }
+
+        // Only cells that can move into this one depend on its g.
+        if (!isPassable(st->grid, st->rows, st->cols, st->dest, row, col))
+        {
+            continue;
+        }
+
+        for (int dir = 0; dir < CONN; dir++)
+        {
+            int newI = row + dirRow[dir];
+            int newJ = col + dirCol[dir];
+            if (isValid(newI, newJ, st->rows, st->cols) && !updateVertex<CONN>(st, start, newI, newJ))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template <int CONN, typename cost_t, int R, int C, int OPEN>
+bool updateVertex(replanState<cost_t, R, C, OPEN>* st, Pair start, int row, int col)
+{
+    if (!isDestination(row, col, st->dest))
+    {
+        cost_t best = FLT_MAX;
+        for (int dir = 0; dir < CONN; dir++)
+        {
+            int newI = row + dirRow[dir];
+            int newJ = col + dirCol[dir];
+            if (isPassable(st->grid, st->rows, st->cols, st->dest, newI, newJ) && st->g[newI][newJ] != FLT_MAX &&
+                st->g[newI][newJ] + (dir >= DIR_NE ? 1.414 : 1.0) < best)
+            {
+                best = st->g[newI][newJ] + (dir >= DIR_NE ? 1.414 : 1.0);
+            }
+        }
+
+        st->rhs[row][col] = best;
+    }
+
+    removePPair(&st->openList, make_pair(row, col));
+    return st->g[row][col] == st->rhs[row][col] ||
+        addPPair(&st->openList, make_pair(calculateKey<CONN>(st, start, row, col), make_pair(row, col)));
+}
+
+template <int CONN, typename cost_t, int R, int C, int OPEN>
+lpaKey<cost_t> calculateKey(replanState<cost_t, R, C, OPEN>* st, Pair start, int row, int col)
+{
+    cost_t m = st->g[row][col] < st->rhs[row][col] ? st->g[row][col] : st->rhs[row][col];
+
+    lpaKey<cost_t> key;
+    key.k1 = m + replanHValue<CONN, cost_t>(row, col, start) + st->km;
+    key.k2 = m;
+    return key;
+}
+
+template <int CONN, typename cost_t>
+cost_t replanHValue(int row, int col, Pair start)
+{
+    // Keys carry over between calls, so h has to stay consistent even
+    // after rounding. Octile and Manhattan are exact on open ground and
+    // Euclidean overestimates a 1.414 diagonal, so shrink h a little.
+    return calculateHValue<cost_t, CONN>(row, col, start) * 0.999;
+}
+
+template <typename cost_t>
+bool operator<(const lpaKey<cost_t>& a, const lpaKey<cost_t>& b)
+{
+    return a.k1 < b.k1 || (a.k1 == b.k1 && a.k2 < b.k2);
+}
+
+template <typename cost_t>
+bool operator<=(const lpaKey<cost_t>& a, const lpaKey<cost_t>& b)
+{
+    return !(b < a);
+}
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void hpaCore(unsigned int gridIn[], int rows, int cols, int rebuild, Pair changed, Pair src, Pair dest, int mode, result* res, pathSummary* summary, Pair pathOut[])
+{
+    if (rows < 1 || rows > R || cols < 1 || cols > C)
+    {
+        setResult(res, summary, INVALID_GRID_SIZE);
+        return;
+    }
+
+    static hpaState<cost_t, R, C> st;
+    const int CW = HPA_CLUSTERS(C);
+    int clusterRows = HPA_CLUSTERS(rows);
+    int clusterCols = HPA_CLUSTERS(cols);
+
+    if (!st.ready || rows != st.rows || cols != st.cols || rebuild == HPA_REBUILD_ALL)
+    {
+        loadGrid(gridIn, rows, cols, st.grid);
+        st.rows = rows;
+        st.cols = cols;
+        st.ready = true;
+
+        for (int c = 0; c < HPA_CLUSTERS(R) * CW; c++)
+        {
+            for (int s = 0; s < HPA_SLOTS; s++)
+            {
+                st.entrance[c][s] = make_pair(-1, -1);
+            }
+        }
+
+        // Every border is the S or E side of exactly one cluster.
+        for (int cr = 0; cr < clusterRows; cr++)
+        {
+            for (int cc = 0; cc < clusterCols; cc++)
+            {
+                if (cr + 1 < clusterRows)
+                {
+                    findEntrances(&st, cr * CW + cc, (cr + 1) * CW + cc, false);
+                }
+
+                if (cc + 1 < clusterCols)
+                {
+                    findEntrances(&st, cr * CW + cc, cr * CW + cc + 1, true);
+                }
+            }
+        }
+
+        for (int cr = 0; cr < clusterRows; cr++)
+        {
+            for (int cc = 0; cc < clusterCols; cc++)
+            {
+                buildCluster<CONN>(&st, cr * CW + cc);
+            }
+        }
+    }
+    else if (rebuild == HPA_REBUILD_CLUSTER && isValid(changed.first, changed.second, rows, cols))
+    {
+        int cr = changed.first / HPA_CLUSTER;
+        int cc = changed.second / HPA_CLUSTER;
+        int words = GRID_WORDS(cols);
+
+        // Only this cluster's cells are read, so changes elsewhere in
+        // grid wait for their own rebuild.
+        for (int x = cr * HPA_CLUSTER; x < rows && x < (cr + 1) * HPA_CLUSTER; x++)
+        {
+            for (int y = cc * HPA_CLUSTER; y < cols && y < (cc + 1) * HPA_CLUSTER; y++)
+            {
+                unsigned int bit = 1u << (y % GRID_WORD_BITS);
+                if (gridIn[x * words + y / GRID_WORD_BITS] & bit)
+                {
+                    st.grid[x][y / GRID_WORD_BITS] |= bit;
+                }
+                else
+                {
+                    st.grid[x][y / GRID_WORD_BITS] &= ~bit;
+                }
+            }
+        }
+
+        // The four borders are shared, so the clusters across them get new
+        // entrances too and have to be rebuilt with this one.
+        for (int side = DIR_N; side <= DIR_W; side++)
+        {
+            int nr = cr + dirRow[side];
+            int nc = cc + dirCol[side];
+            if (nr < 0 || nr >= clusterRows || nc < 0 || nc >= clusterCols)
+            {
+                continue;
+            }
+
+            if (side == DIR_N || side == DIR_W)
+            {
+                findEntrances(&st, nr * CW + nc, cr * CW + cc, side == DIR_W);
+            }
+            else
+            {
+                findEntrances(&st, cr * CW + cc, nr * CW + nc, side == DIR_E);
+            }
+
+            buildCluster<CONN>(&st, nr * CW + nc);
+        }
+
+        buildCluster<CONN>(&st, cr * CW + cc);
+    }
+
+    if (!isValid(src.first, src.second, rows, cols))
+    {
+        setResult(res, summary, INVALID_SOURCE);
+        return;
+    }
+
+    if (!isValid(dest.first, dest.second, rows, cols))
+    {
+        setResult(res, summary, INVALID_DESTINATION);
+        return;
+    }
+
+    if (!isUnBlocked(st.grid, src.first, src.second) ||
+        !isUnBlocked(st.grid, dest.first, dest.second))
+    {
+        setResult(res, summary, PATH_IS_BLOCKED);
+        return;
+    }
+
+    if (isDestination(src.first, src.second, dest))
+    {
+        setResult(res, summary, ALREADY_AT_DESTINATION);
+        return;
+    }
+
+    // Endpoints in the same or touching clusters lose the most to the
+    // detours through entrances and gain little from the graph, so they
+    // get the flat search, which stays within a few clusters here.
+    int clusterDr = src.first / HPA_CLUSTER - dest.first / HPA_CLUSTER;
+    int clusterDc = src.second / HPA_CLUSTER - dest.second / HPA_CLUSTER;
+    if (clusterDr >= -1 && clusterDr <= 1 && clusterDc >= -1 && clusterDc <= 1)
+    {
+        searchGrid<R, C, CONN, cost_t, OPEN>(st.grid, rows, cols, src, dest, SEARCH_ASTAR, mode == OUTPUT_COST ? OUTPUT_COST : OUTPUT_PATH, res, summary, pathOut, rows * cols, 0);
+        return;
+    }
+
+    const int SRC = HPA_SLOTS;
+    const int DEST = HPA_SLOTS + 1;
+    int srcCluster = (src.first / HPA_CLUSTER) * CW + src.second / HPA_CLUSTER;
+    int destCluster = (dest.first / HPA_CLUSTER) * CW + dest.second / HPA_CLUSTER;
+    int expanded = 0;
+
+    // src and dest join the entrance graph through their own clusters.
+    expanded += clusterSearch<CONN>(&st, srcCluster, src, dest);
+    memcpy(st.srcRoute, st.localDir, sizeof(st.srcRoute));
+    for (int s = 0; s < HPA_SLOTS; s++)
+    {
+        st.srcDist[s] = st.entrance[srcCluster][s].first == -1 ? (cost_t)FLT_MAX : clusterDistance(&st, srcCluster, st.entrance[srcCluster][s]);
+    }
+    st.srcDist[DEST] = srcCluster == destCluster ? clusterDistance(&st, srcCluster, dest) : (cost_t)FLT_MAX;
+
+    expanded += clusterSearch<CONN>(&st, destCluster, dest, make_pair(-1, -1));
+    memcpy(st.destRoute, st.localDir, sizeof(st.destRoute));
+    for (int s = 0; s < HPA_SLOTS; s++)
+    {
+        st.destDist[s] = st.entrance[destCluster][s].first == -1 ? (cost_t)FLT_MAX : clusterDistance(&st, destCluster, st.entrance[destCluster][s]);
+    }
+
+    for (int c = 0; c < clusterRows * CW; c++)
+    {
+        for (int s = 0; s <= DEST; s++)
+        {
+            st.g[c][s] = FLT_MAX;
+            st.openList.pos[c][s] = -1;
+        }
+    }
+
+    st.openList.size = 0;
+    st.g[srcCluster][SRC] = 0.0;
+    addPPair(&st.openList, make_pair(calculateHValue<cost_t, CONN>(src.first, src.second, dest), make_pair(srcCluster, SRC)));
+
+    bool foundDest = false;
+    while (!checkForEmpty(&st.openList))
+    {
+        pair<cost_t, Pair> p = getNext(&st.openList);
+        expanded++;
+
+        int c = p.second.first;
+        int s = p.second.second;
+        if (s == DEST)
+        {
+            foundDest = true;
+            break;
+        }
+
+        for (int t = 0; t <= DEST; t++)
+        {
+            cost_t w;
+            if (s == SRC)
+            {
+                w = t == SRC ? (cost_t)FLT_MAX : st.srcDist[t];
+            }
+            else if (t == DEST)
+            {
+                w = c == destCluster ? st.destDist[s] : (cost_t)FLT_MAX;
+            }
+            else
+            {
+                w = t == SRC || t == s || st.entrance[c][t].first == -1 ? (cost_t)FLT_MAX : st.dist[c][s][t];
+            }
+
+            if (w != FLT_MAX)
+            {
+                relaxNode<CONN>(&st, p.second, make_pair(c, t), w, src, dest);
+            }
+        }
+
+        // An entrance also steps straight across its border.
+        if (s != SRC)
+        {
+            int side = s / HPA_ENTRANCES;
+            int across = c + dirRow[side] * CW + dirCol[side];
+            relaxNode<CONN>(&st, p.second, make_pair(across, dirReverse[side] * HPA_ENTRANCES + s % HPA_ENTRANCES), (cost_t)1.0, src, dest);
+        }
+    }
+
+    if (!foundDest)
+    {
+        // Entrances only cover straight crossings, so a route that can
+        // only leave a cluster diagonally is left to the flat search.
+        searchGrid<R, C, CONN, cost_t, OPEN>(st.grid, rows, cols, src, dest, SEARCH_ASTAR, mode == OUTPUT_COST ? OUTPUT_COST : OUTPUT_PATH, res, summary, pathOut, rows * cols, 0);
+        summary->expanded += expanded;
+        return;
+    }
+
+    int hops = 0;
+    for (Pair n = make_pair(destCluster, DEST); ; n = st.parent[n.first][n.second])
+    {
+        st.chain[hops++] = n;
+        if (n.second == SRC)
+        {
+            break;
+        }
+    }
+
+    // Refine the hops from src onwards. The hop into dest follows the dest
+    // search back from the entrance; every other hop inside a cluster is
+    // rooted at its start.
+    bool writePath = mode == OUTPUT_PATH;
+    int length = 1;
+    cost_t cost = 0.0;
+    if (writePath)
+    {
+        pathOut[0] = src;
+    }
+
+    for (int k = hops - 1; k > 0; k--)
+    {
+        Pair from = st.chain[k];
+        Pair to = st.chain[k - 1];
+        Pair fromCell = nodeCell(&st, from, src, dest);
+        Pair toCell = nodeCell(&st, to, src, dest);
+
+        if (from.second == SRC)
+        {
+            length = refineHop<C>(from.first, st.srcRoute, fromCell, toCell, true, pathOut, length, rows * cols, writePath, &cost);
+        }
+        else if (to.second == DEST)
+        {
+            length = refineHop<C>(from.first, st.destRoute, fromCell, toCell, false, pathOut, length, rows * cols, writePath, &cost);
+        }
+        else if (from.first == to.first)
+        {
+            length = refineHop<C>(from.first, st.route[from.first][from.second], fromCell, toCell, true, pathOut, length, rows * cols, writePath, &cost);
+        }
+        else
+        {
+            if (writePath && length < rows * cols)
+            {
+                pathOut[length] = toCell;
+            }
+            length++;
+            cost += 1.0;
+        }
+    }
+
+    setResult(res, summary, FOUND_PATH);
+    summary->expanded = expanded;
+    summary->length = length;
+    summary->cost = cost;
+
+    if (writePath && length > rows * cols)
+    {
+        *res = PATH_OUTPUT_FULL;
+    }
+}
+
+template <int CONN, typename cost_t, int R, int C>
+void buildCluster(hpaState<cost_t, R, C>* st, int cluster)
+{
+    for (int s = 0; s < HPA_SLOTS; s++)
+    {
+        if (st->entrance[cluster][s].first == -1)
+        {
+            continue;
+        }
+
+        clusterSearch<CONN>(st, cluster, st->entrance[cluster][s], make_pair(-1, -1));
+        memcpy(st->route[cluster][s], st->localDir, sizeof(st->localDir));
+        for (int t = 0; t < HPA_SLOTS; t++)
+        {
+            st->dist[cluster][s][t] = st->entrance[cluster][t].first == -1 ? (cost_t)FLT_MAX : clusterDistance(st, cluster, st->entrance[cluster][t]);
+        }
+    }
+}
+
+template <typename cost_t, int R, int C>
+void findEntrances(hpaState<cost_t, R, C>* st, int first, int second, bool vertical)
+{
+    // first is above or left of second; the border runs along second's
+    // N or W side.
+    const int CW = HPA_CLUSTERS(C);
+    int r0 = (second / CW) * HPA_CLUSTER;
+    int c0 = (second % CW) * HPA_CLUSTER;
+    int firstSide = vertical ? DIR_E : DIR_S;
+    int secondSide = vertical ? DIR_W : DIR_N;
+    int length = vertical ? st->rows - r0 : st->cols - c0;
+    if (length > HPA_CLUSTER)
+    {
+        length = HPA_CLUSTER;
+    }
+
+    for (int e = 0; e < HPA_ENTRANCES; e++)
+    {
+        st->entrance[first][firstSide * HPA_ENTRANCES + e] = make_pair(-1, -1);
+        st->entrance[second][secondSide * HPA_ENTRANCES + e] = make_pair(-1, -1);
+    }
+
+    int e = 0;
+    int run = 0;
+    for (int k = 0; k <= length; k++)
+    {
+        Pair a = vertical ? make_pair(r0 + k, c0 - 1) : make_pair(r0 - 1, c0 + k);
+        Pair b = vertical ? make_pair(r0 + k, c0) : make_pair(r0, c0 + k);
+        if (k < length && isUnBlocked(st->grid, a.first, a.second) && isUnBlocked(st->grid, b.first, b.second))
+        {
+            run++;
+            continue;
+        }
+
+        // A long opening gets an entrance at each end so paths along it
+        // are not bent through its middle; a short one gets just its
+        // middle cell.
+        for (int end = 0; run > 0 && end < (run >= 6 ? 2 : 1) && e < HPA_ENTRANCES; end++, e++)
+        {
+            int at = run >= 6 ? (end == 0 ? k - run : k - 1) : k - run + run / 2;
+            st->entrance[first][firstSide * HPA_ENTRANCES + e] = vertical ? make_pair(r0 + at, c0 - 1) : make_pair(r0 - 1, c0 + at);
+            st->entrance[second][secondSide * HPA_ENTRANCES + e] = vertical ? make_pair(r0 + at, c0) : make_pair(r0, c0 + at);
+        }
+
+        run = 0;
+    }
+}
+
+template <int CONN, typename cost_t, int R, int C>
+int clusterSearch(hpaState<cost_t, R, C>* st, int cluster, Pair from, Pair dest)
+{
+    const int CW = HPA_CLUSTERS(C);
+    int r0 = (cluster / CW) * HPA_CLUSTER;
+    int c0 = (cluster % CW) * HPA_CLUSTER;
+    int height = st->rows - r0 < HPA_CLUSTER ? st->rows - r0 : HPA_CLUSTER;
+    int width = st->cols - c0 < HPA_CLUSTER ? st->cols - c0 : HPA_CLUSTER;
+
+    for (int x = 0; x < height; x++)
+    {
+        for (int y = 0; y < width; y++)
+        {
+            st->local[x][y] = FLT_MAX;
+            st->localOpen.pos[x][y] = -1;
+        }
+    }
+
+    st->localOpen.size = 0;
+    st->local[from.first - r0][from.second - c0] = 0.0;
+    addPPair(&st->localOpen, make_pair((cost_t)0.0, make_pair(from.first - r0, from.second - c0)));
+
+    // Plain Dijkstra: every entrance of the cluster wants its distance.
+    int expanded = 0;
+    while (!checkForEmpty(&st->localOpen))
+    {
+        pair<cost_t, Pair> p = getNext(&st->localOpen);
+        expanded++;
+
+        int i = p.second.first;
+        int j = p.second.second;
+
+        // Paths stop at dest, as in the flat search.
+        if (isDestination(r0 + i, c0 + j, dest) && !isDestination(r0 + i, c0 + j, from))
+        {
+            continue;
+        }
+
+        for (int dir = 0; dir < CONN; dir++)
+        {
+            int newI = i + dirRow[dir];
+            int newJ = j + dirCol[dir];
+            if (newI < 0 || newI >= height || newJ < 0 || newJ >= width ||
+                !isPassable(st->grid, st->rows, st->cols, dest, r0 + newI, c0 + newJ))
+            {
+                continue;
+            }
+
+            cost_t newG = st->local[i][j] + (dir >= DIR_NE ? 1.414 : 1.0);
+            if (newG < st->local[newI][newJ])
+            {
+                st->local[newI][newJ] = newG;
+                st->localDir[newI][newJ] = dir;
+                addPPair(&st->localOpen, make_pair(newG, make_pair(newI, newJ)));
+            }
+        }
+    }
+
+    return expanded;
+}
+
+template <typename cost_t, int R, int C>
+cost_t clusterDistance(hpaState<cost_t, R, C>* st, int cluster, Pair to)
+{
+    const int CW = HPA_CLUSTERS(C);
+    return st->local[to.first - (cluster / CW) * HPA_CLUSTER][to.second - (cluster % CW) * HPA_CLUSTER];
+}
+
+template <typename cost_t, int R, int C>
+Pair nodeCell(hpaState<cost_t, R, C>* st, Pair node, Pair src, Pair dest)
+{
+    if (node.second == HPA_SLOTS)
+    {
+        return src;
+    }
+
+    return node.second == HPA_SLOTS + 1 ? dest : st->entrance[node.first][node.second];
+}
+
+template <int CONN, typename cost_t, int R, int C>
+void relaxNode(hpaState<cost_t, R, C>* st, Pair from, Pair to, cost_t w, Pair src, Pair dest)
+{
+    cost_t newG = st->g[from.first][from.second] + w;
+    if (newG < st->g[to.first][to.second])
+    {
+        Pair cell = nodeCell(st, to, src, dest);
+        st->g[to.first][to.second] = newG;
+        st->parent[to.first][to.second] = from;
+
+        // The open list holds every node at once, so this cannot fail.
+        addPPair(&st->openList, make_pair(newG + calculateHValue<cost_t, CONN>(cell.first, cell.second, dest), to));
+    }
+}
+
+template <int C, typename cost_t>
+int refineHop(int cluster, unsigned char route[][HPA_CLUSTER], Pair from, Pair to, bool fromRoot, Pair pathOut[], int length, int capacity, bool writePath, cost_t* cost)
+{
+    const int CW = HPA_CLUSTERS(C);
+    int r0 = (cluster / CW) * HPA_CLUSTER;
+    int c0 = (cluster % CW) * HPA_CLUSTER;
+
+    // Parents lead back to the root, so a hop from the root has to be
+    // counted first and then written back to front.
+    Pair walk = fromRoot ? to : from;
+    Pair root = fromRoot ? from : to;
+    int steps = 0;
+    for (Pair p = walk; p != root; steps++)
+    {
+        int dir = route[p.first - r0][p.second - c0];
+        p = make_pair(p.first - dirRow[dir], p.second - dirCol[dir]);
+    }
+
+    Pair p = walk;
+    for (int k = 0; k < steps; k++)
+    {
+        int dir = route[p.first - r0][p.second - c0];
+        int at = fromRoot ? length + steps - 1 - k : length + k;
+        Pair next = make_pair(p.first - dirRow[dir], p.second - dirCol[dir]);
+        if (writePath && at < capacity)
+        {
+            pathOut[at] = fromRoot ? p : next;
+        }
+
+        *cost += dir >= DIR_NE ? 1.414 : 1.0;
+        p = next;
+    }
+
+    return length + steps;
+}
+
+extern "C"
+{
+    void asearch(unsigned int gridIn[], int rows, int cols, Pair src, Pair dest, int search, int mode, result* res, pathSummary* summary, Pair pathOut[], cell cellOut[])
+    {
+#pragma HLS INTERFACE m_axi port=gridIn bundle=gmem_grid max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=res bundle=gmem_res max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=summary bundle=gmem_summary max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=pathOut bundle=gmem_path max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=cellOut bundle=gmem_cells max_widen_bitwidth=512
+        searchCore<MAX_ROW, MAX_COL, 8, double, OPEN_MAX>(gridIn, rows, cols, src, dest, search, mode, res, summary, pathOut, cellOut);
+    }
+
+    void asearch_64x64_8c(unsigned int gridIn[], int rows, int cols, Pair src, Pair dest, int search, int mode, result* res, pathSummary* summary, Pair pathOut[], cell cellOut[])
+    {
+#pragma HLS INTERFACE m_axi port=gridIn bundle=gmem_grid max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=res bundle=gmem_res max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=summary bundle=gmem_summary max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=pathOut bundle=gmem_path max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=cellOut bundle=gmem_cells max_widen_bitwidth=512
+        if (rows != 64 || cols != 64)
+        {
+            setResult(res, summary, INVALID_GRID_SIZE);
+            return;
+        }
+
+        searchCore<64, 64, 8, float, 64 * 64>(gridIn, 64, 64, src, dest, search, mode, res, summary, pathOut, cellOut);
+    }
+
+    void asearch_32x32_4c(unsigned int gridIn[], int rows, int cols, Pair src, Pair dest, int search, int mode, result* res, pathSummary* summary, Pair pathOut[], cell cellOut[])
+    {
+#pragma HLS INTERFACE m_axi port=gridIn bundle=gmem_grid max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=res bundle=gmem_res max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=summary bundle=gmem_summary max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=pathOut bundle=gmem_path max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=cellOut bundle=gmem_cells max_widen_bitwidth=512
+        if (rows != 32 || cols != 32)
+        {
+            setResult(res, summary, INVALID_GRID_SIZE);
+            return;
+        }
+
+        searchCore<32, 32, 4, float, 32 * 32>(gridIn, 32, 32, src, dest, search, mode, res, summary, pathOut, cellOut);
+    }
+
+    void asearch_batch(unsigned int gridIn[], int rows, int cols, int count, query queries[], int mode, queryResult results[], Pair pathOut[], int pathCapacity)
+    {
+#pragma HLS INTERFACE m_axi port=gridIn bundle=gmem_grid max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=queries bundle=gmem_queries max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=results bundle=gmem_results max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=pathOut bundle=gmem_path max_widen_bitwidth=512
+        batchCore<MAX_ROW, MAX_COL, 8, double, OPEN_MAX>(gridIn, rows, cols, count, queries, mode, results, pathOut, pathCapacity);
+    }
+
+    void asearch_serve(unsigned int gridIn[], int rows, int cols, query ring[], volatile int doorbell[], queryResult results[], volatile int done[], Pair pathOut[], int ringSize, int mode)
+    {
+#pragma HLS INTERFACE m_axi port=gridIn bundle=gmem_grid max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=ring bundle=gmem_queries max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=doorbell bundle=gmem_doorbell
+        // A done flag must not overtake the result and path it announces,
+        // and writes are only kept in order within one bundle.
+#pragma HLS INTERFACE m_axi port=results bundle=gmem_results max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=done bundle=gmem_results max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=pathOut bundle=gmem_results max_widen_bitwidth=512
+        serveCore<MAX_ROW, MAX_COL, 8, double, OPEN_MAX>(gridIn, rows, cols, ring, doorbell, results, done, pathOut, ringSize, mode);
+    }
+
+    void asearch_replan(unsigned int gridIn[], int rows, int cols, Pair src, Pair dest, int reset, cellChange changes[], int changeCount, int mode, result* res, pathSummary* summary, Pair pathOut[])
+    {
+#pragma HLS INTERFACE m_axi port=gridIn bundle=gmem_grid max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=changes bundle=gmem_changes max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=res bundle=gmem_res max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=summary bundle=gmem_summary max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=pathOut bundle=gmem_path max_widen_bitwidth=512
+        replanCore<MAX_ROW, MAX_COL, 8, double, OPEN_MAX>(gridIn, rows, cols, src, dest, reset, changes, changeCount, mode, res, summary, pathOut);
+    }
+
+    void asearch_hpa(unsigned int gridIn[], int rows, int cols, int rebuild, Pair changed, Pair src, Pair dest, int mode, result* res, pathSummary* summary, Pair pathOut[])
+    {
+#pragma HLS INTERFACE m_axi port=gridIn bundle=gmem_grid max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=res bundle=gmem_res max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=summary bundle=gmem_summary max_widen_bitwidth=512
+#pragma HLS INTERFACE m_axi port=pathOut bundle=gmem_path max_widen_bitwidth=512
+        hpaCore<MAX_ROW, MAX_COL, 8, double, OPEN_MAX>(gridIn, rows, cols, rebuild, changed, src, dest, mode, res, summary, pathOut);
+    }
+}
+
+void setResult(result* res, pathSummary* summary, result r)
+{
+    *res = r;
+    summary->length = 0;
+    summary->cost = 0.0;
+    summary->expanded = 0;
+}
+
+template <int W>
+void loadGrid(unsigned int gridIn[], int rows, int cols, unsigned int grid[][W])
+{
+    // One flat loop over the packed words, so the whole grid is read in
+    // a single burst instead of one short burst per row.
+    int words = GRID_WORDS(cols);
+    int x = 0;
+    int w = 0;
+    for (int i = 0; i < rows * words; i++)
+    {
+#pragma HLS PIPELINE II=1
+        grid[x][w] = gridIn[i];
+        if (++w == words)
+        {
+            w = 0;
+            x++;
+        }
+    }
+}
+
+bool isValid(int row, int col, int rows, int cols)
+{
+    return (row >= 0) &&
+        (row < rows) &&
+        (col >= 0) &&
+        (col < cols);
+}
+
+template <int W>
+bool isUnBlocked(unsigned int grid[][W], int row, int col)
+{
+    return testBit(grid, row, col);
+}
+
+template <int W>
+bool testBit(unsigned int bits[][W], int row, int col)
+{
+    return (bits[row][col / GRID_WORD_BITS] >> (col % GRID_WORD_BITS)) & 1;
+}
+
+template <int W>
+void setBit(unsigned int bits[][W], int row, int col)
+{
+    bits[row][col / GRID_WORD_BITS] |= 1u << (col % GRID_WORD_BITS);
+}
+
+template <int W>
+void clearBit(unsigned int bits[][W], int row, int col)
+{
+    bits[row][col / GRID_WORD_BITS] &= ~(1u << (col % GRID_WORD_BITS));
+}
+
+template <int W>
+void readNeighbourWords(unsigned int bits[][W], int row, int col, int rows, int cols, unsigned int lo[3], unsigned int hi[3])
+{
+    int loCol = col > 0 ? col - 1 : col;
+    int hiCol = col + 1 < cols ? col + 1 : col;
+    for (int r = 0; r < 3; r++)
+    {
+#pragma HLS UNROLL
+        int x = row + r - 1;
+        bool inside = x >= 0 && x < rows;
+        lo[r] = inside ? bits[x][loCol / GRID_WORD_BITS] : 0;
+        hi[r] = inside ? bits[x][hiCol / GRID_WORD_BITS] : 0;
+    }
+}
+
+bool neighbourBit(const unsigned int lo[3], const unsigned int hi[3], int r, int centre, int col)
+{
+    int loCol = centre > 0 ? centre - 1 : centre;
+    unsigned int word = col / GRID_WORD_BITS == loCol / GRID_WORD_BITS ? lo[r] : hi[r];
+    return (word >> (col % GRID_WORD_BITS)) & 1;
+}
+
+template <int W>
+int getParent(unsigned int parent[][W], int row, int col)
+{
+    int shift = (col % PARENT_PER_WORD) * PARENT_BITS;
+    return (parent[row][col / PARENT_PER_WORD] >> shift) & 0x7;
+}
+
+template <int W>
+void setParent(unsigned int parent[][W], int row, int col, int dir)
+{
+    int shift = (col % PARENT_PER_WORD) * PARENT_BITS;
+    unsigned int word = parent[row][col / PARENT_PER_WORD] & ~(0x7u << shift);
+    parent[row][col / PARENT_PER_WORD] = word | ((unsigned int)dir << shift);
+}
+
+bool isDestination(int row, int col, Pair dest)
+{
+    return row == dest.first && col == dest.second;
+}
+
+template <int W>
+bool isPassable(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col)
+{
+    return isValid(row, col, rows, cols) &&
+        (isDestination(row, col, dest) || isUnBlocked(grid, row, col));
+}
+
+template <int W>
+bool hasForcedNeighbour(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col, int dir)
+{
+    int dr = dirRow[dir];
+    int dc = dirCol[dir];
+
+    if (dr != 0 && dc != 0)
+    {
+        return (isPassable(grid, rows, cols, dest, row + dr, col - dc) && !isPassable(grid, rows, cols, dest, row, col - dc)) ||
+            (isPassable(grid, rows, cols, dest, row - dr, col + dc) && !isPassable(grid, rows, cols, dest, row - dr, col));
+    }
+
+    if (dr != 0)
+    {
+        return (isPassable(grid, rows, cols, dest, row + dr, col + 1) && !isPassable(grid, rows, cols, dest, row, col + 1)) ||
+            (isPassable(grid, rows, cols, dest, row + dr, col - 1) && !isPassable(grid, rows, cols, dest, row, col - 1));
+    }
+
+    return (isPassable(grid, rows, cols, dest, row + 1, col + dc) && !isPassable(grid, rows, cols, dest, row + 1, col)) ||
+        (isPassable(grid, rows, cols, dest, row - 1, col + dc) && !isPassable(grid, rows, cols, dest, row - 1, col));
+}
+
+template <int W>
+bool isJumpDirection(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col, int from, int dir)
+{
+    if (from == -1)
+    {
+        return true;
+    }
+
+    int dr = dirRow[from];
+    int dc = dirCol[from];
+    int nr = dirRow[dir];
+    int nc = dirCol[dir];
+
+    if (dr != 0 && dc != 0)
+    {
+        if ((nr == dr || nr == 0) && (nc == dc || nc == 0))
+        {
+            return true;
+        }
+
+        if (nr == dr && nc == -dc)
+        {
+            return !isPassable(grid, rows, cols, dest, row, col - dc);
+        }
+
+        if (nr == -dr && nc == dc)
+        {
+            return !isPassable(grid, rows, cols, dest, row - dr, col);
+        }
+
+        return false;
+    }
+
+    // Straight on, or a diagonal round an obstacle beside the cell.
+    if (dr != 0)
+    {
+        return nr == dr && (nc == 0 || !isPassable(grid, rows, cols, dest, row, col + nc));
+    }
+
+    return nc == dc && (nr == 0 || !isPassable(grid, rows, cols, dest, row + nr, col));
+}
+
+template <int W>
+bool jumpStraight(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col, int dir)
+{
+    while (true)
+    {
+        row += dirRow[dir];
+        col += dirCol[dir];
+
+        if (!isPassable(grid, rows, cols, dest, row, col))
+        {
+            return false;
+        }
+
+        if (isDestination(row, col, dest) || hasForcedNeighbour(grid, rows, cols, dest, row, col, dir))
+        {
+            return true;
+        }
+    }
+}
+
+template <int W>
+bool jump(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col, int dir, int* jumpI, int* jumpJ)
+{
+    int dr = dirRow[dir];
+    int dc = dirCol[dir];
+    bool diagonal = dr != 0 && dc != 0;
+
+    while (true)
+    {
+        row += dr;
+        col += dc;
+
+        if (!isPassable(grid, rows, cols, dest, row, col))
+        {
+            return false;
+        }
+
+        // A diagonal run also stops wherever one of its straight
+        // components would find a jump point.
+        if (isDestination(row, col, dest) ||
+            hasForcedNeighbour(grid, rows, cols, dest, row, col, dir) ||
+            (diagonal && (jumpStraight(grid, rows, cols, dest, row, col, dr < 0 ? DIR_N : DIR_S) ||
+                jumpStraight(grid, rows, cols, dest, row, col, dc > 0 ? DIR_E : DIR_W))))
+        {
+            *jumpI = row;
+            *jumpJ = col;
+            return true;
+        }
+    }
+}
+
+template <typename cost_t, int CONN>
+cost_t calculateHValue(int row, int col, Pair dest)
+{
+    int rowDiff = row > dest.first ? row - dest.first : dest.first - row;
+    int colDiff = col > dest.second ? col - dest.second : dest.second - col;
+
+    return connHeuristic<CONN>::type::template value<cost_t, CONN>(rowDiff, colDiff);
+}
+
+template <typename cost_t>
+bool checkF(cost_t g, cost_t h, cost_t f)
+{
+    return g == FLT_MAX || g + h > f;
+}
+
+template <typename cost_t, int R, int C>
+int buildPath(unsigned int parent[][PARENT_WORDS(C)], Pair src, Pair dest, Pair pathOut[], bool writePath, int capacity, cost_t* cost)
+{
+    // The walk goes dest to src, so keep it on chip and write it out in
+    // src to dest order, which lets the writes burst. No path visits a
+    // cell twice, so it fits in R * C and the walk never goes further.
+    static Pair trail[R * C];
+    int length = 1;
+    int row = dest.first;
+    int col = dest.second;
+    trail[0] = make_pair(row, col);
+    while (!(row == src.first && col == src.second) && length < R * C)
+    {
+        int dir = getParent(parent, row, col);
+        *cost += dir >= DIR_NE ? 1.414 : 1.0;
+        row -= dirRow[dir];
+        col -= dirCol[dir];
+        trail[length++] = make_pair(row, col);
+    }
+
+    if (writePath && length <= capacity)
+    {
+        for (int i = 0; i < length; i++)
+        {
+#pragma HLS PIPELINE II=1
+            pathOut[i] = trail[length - 1 - i];
+        }
+    }
+
+    return length;
+}
+
+template <typename cost_t, int R, int C, int OPEN>
+void beginQuery(searchWorkspace<cost_t, R, C, OPEN>* ws)
+{
+    ws->generation++;
+
+    // Stamps from 65535 queries ago would match again after the wrap, so
+    // pay for one full clear here instead.
+    if (ws->generation == 0)
+    {
+        for (int i = 0; i < R; i++)
+        {
+            for (int j = 0; j < C; j++)
+            {
+                ws->stamp[i][j] = 0;
+            }
+        }
+
+        ws->generation = 1;
+    }
+
+    ws->openList.size = 0;
+}
+
+template <typename cost_t, int R, int C, int OPEN>
+void touch(searchWorkspace<cost_t, R, C, OPEN>* ws, int row, int col)
+{
+    if (ws->stamp[row][col] != ws->generation)
+    {
+        ws->stamp[row][col] = ws->generation;
+        ws->g[row][col] = FLT_MAX;
+        ws->openList.pos[row][col] = -1;
+        clearBit(ws->closed, row, col);
+    }
+}
+
+template <typename cost_t, int R, int C, int CAP>
+bool checkForEmpty(openHeap<cost_t, R, C, CAP>* heap)
+{
+    return heap->size == 0;
+}
+
+template <typename cost_t, int R, int C, int CAP>
+pair<cost_t, Pair> getNext(openHeap<cost_t, R, C, CAP>* heap)
+{
+    pair<cost_t, Pair> top = heap->nodes[0];
+    heap->pos[top.second.first][top.second.second] = -1;
+
+    heap->size--;
+    if (heap->size > 0)
+    {
+        heap->nodes[0] = heap->nodes[heap->size];
+        siftDown(heap, 0);
+    }
+
+    return top;
+}
+
+template <typename cost_t, int R, int C, int CAP>
+bool addPPair(openHeap<cost_t, R, C, CAP>* heap, const pair<cost_t, Pair>& pair)
+{
+    int index = heap->pos[pair.second.first][pair.second.second];
+
+    if (index == -1)
+    {
+        if (heap->size == CAP)
+        {
+            return false;
+        }
+
+        index = heap->size;
+        heap->size++;
+    }
+
+    // Callers only ever lower f (see checkF), so a cell that is already
+    // queued is a decrease-key and only has to move towards the root.
+    heap->nodes[index] = pair;
+    siftUp(heap, index);
+
+    return true;
+}
+
+template <typename cost_t, int R, int C, int CAP>
+void removePPair(openHeap<cost_t, R, C, CAP>* heap, Pair cell)
+{
+    int index = heap->pos[cell.first][cell.second];
+    if (index == -1)
+    {
+        return;
+    }
+
+    heap->pos[cell.first][cell.second] = -1;
+    heap->size--;
+    if (index == heap->size)
+    {
+        return;
+    }
+
+    // The last node fills the hole and may belong above or below it.
+    pair<cost_t, Pair> last = heap->nodes[heap->size];
+    heap->nodes[index] = last;
+    siftDown(heap, index);
+    siftUp(heap, heap->pos[last.second.first][last.second.second]);
+}
+
+template <typename cost_t, int R, int C, int CAP>
+void siftUp(openHeap<cost_t, R, C, CAP>* heap, int index)
+{
+    pair<cost_t, Pair> node = heap->nodes[index];
+
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        pair<cost_t, Pair> p = heap->nodes[parent];
+        if (p.first <= node.first)
+        {
+            break;
+        }
+
+        heap->nodes[index] = p;
+        heap->pos[p.second.first][p.second.second] = index;
+        index = parent;
+    }
+
+    heap->nodes[index] = node;
+    heap->pos[node.second.first][node.second.second] = index;
+}
+
+template <typename cost_t, int R, int C, int CAP>
+void siftDown(openHeap<cost_t, R, C, CAP>* heap, int index)
+{
+    pair<cost_t, Pair> node = heap->nodes[index];
+
+    while (true)
+    {
+        int child = 2 * index + 1;
+        if (child >= heap->size)
+        {
+            break;
+        }
+
+        if (child + 1 < heap->size &&
+            heap->nodes[child + 1].first < heap->nodes[child].first)
+        {
+            child++;
+        }
+
+        pair<cost_t, Pair> c = heap->nodes[child];
+        if (node.first <= c.first)
+        {
+            break;
+        }
+
+        heap->nodes[index] = c;
+        heap->pos[c.second.first][c.second.second] = index;
+        index = child;
+    }
+
+    heap->nodes[index] = node;
+    heap->pos[node.second.first][node.second.second] = index;
 }
@@ -4,8 +4,57 @@
 #ifndef ASEARCH_H_
 #define ASEARCH_H_
 
-#define ROW 9
-#define COL 10
+// Largest grid a kernel build accepts. The grid size itself is passed
+// at run time; these only size the on-chip arrays.
+#ifndef MAX_ROW
+#define MAX_ROW 64
+#endif
+#ifndef MAX_COL
+#define MAX_COL 64
+#endif
+
+// Grids are passed bit-packed: each row starts on a new 32-bit word and
+// bit (col % 32) of word (col / 32) is set when the cell is unblocked.
+#define GRID_WORD_BITS 32
+#define GRID_WORDS(cols) (((cols) + GRID_WORD_BITS - 1) / GRID_WORD_BITS)
+
+// Parent directions are stored 3 bits per cell, 10 cells to a word.
+#define PARENT_BITS 3
+#define PARENT_PER_WORD 10
+#define PARENT_WORDS(cols) (((cols) + PARENT_PER_WORD - 1) / PARENT_PER_WORD)
+
+// Open list capacity. Each cell is on the open list at most once, so
+// MAX_ROW * MAX_COL never overflows; lower it to trade BRAM for
+// OPEN_LIST_FULL.
+#ifndef OPEN_MAX
+#define OPEN_MAX (MAX_ROW * MAX_COL)
+#endif
+
+// Landmarks used by SEARCH_ALT. Each one costs an R x C distance table.
+#ifndef ALT_LANDMARKS
+#define ALT_LANDMARKS 4
+#endif
+
+// SEARCH_KBEST pops KBEST_LANES nodes at a time and expands them side by
+// side. It stops once its path costs at most KBEST_BOUND times the lowest
+// f left on the open list, so 1.0 keeps it optimal and 1.1 allows paths
+// up to 10% dearer in exchange for fewer expansions.
+#ifndef KBEST_LANES
+#define KBEST_LANES 4
+#endif
+#ifndef KBEST_BOUND
+#define KBEST_BOUND 1.0
+#endif
+
+// asearch_hpa cuts the grid into HPA_CLUSTER x HPA_CLUSTER clusters.
+// Each entrance takes an opening and the blocked cell after it, so a side
+// holds at most HPA_ENTRANCES of them.
+#ifndef HPA_CLUSTER
+#define HPA_CLUSTER 8
+#endif
+#define HPA_ENTRANCES ((HPA_CLUSTER + 1) / 2)
+#define HPA_SLOTS (4 * HPA_ENTRANCES)
+#define HPA_CLUSTERS(cells) (((cells) + HPA_CLUSTER - 1) / HPA_CLUSTER)
 
 #include <utility>
 #include <cstring>
@@ -13,6 +62,23 @@
 #include <math.h>
 #include <stack>
 #include <float.h>
+#include <type_traits>
+#include <stdio.h>
+#ifdef ASEARCH_NATIVE
+#include "asearch_native_stream.h"
+#else
+#include "hls_stream.h"
+#endif
+
+// Kernel diagnostics: 0 prints nothing, 1 prints the search phases and 2
+// also dumps the grid and closed list on every call. Keep release builds
+// at 0 and request OUTPUT_DETAILS to inspect a single query instead.
+#ifndef ASEARCH_DEBUG
+#define ASEARCH_DEBUG 0
+#endif
+
+#define DEBUG_LOG(level, ...) \
+    do { if (ASEARCH_DEBUG >= (level)) printf(__VA_ARGS__); } while (0)
 
 
 using namespace std;
@@ -27,45 +93,510 @@ extern "C"
         INVALID_DESTINATION = 2,
         PATH_IS_BLOCKED = 3,
         ALREADY_AT_DESTINATION = 4,
+        OPEN_LIST_FULL = 5,
+        INVALID_GRID_SIZE = 6,
+        PATH_OUTPUT_FULL = 7,
     };
 
     typedef pair<int, int> Pair;
 
     typedef pair<double, pair<int, int>> pPair;
 
+    enum cellState
+    {
+        CELL_UNREACHED = 0,
+        CELL_OPEN = 1,
+        CELL_CLOSED = 2,
+    };
+
     struct cell
     {
         int parent_i, parent_j;
 
         double f, g, h;
+
+        int state;
+    };
+
+    // What a kernel writes back besides the result code. Details returns
+    // every cell through cellOut, path only the waypoints through pathOut
+    // and cost neither; all three fill in the path summary.
+    enum outputMode
+    {
+        OUTPUT_DETAILS = 0,
+        OUTPUT_PATH = 1,
+        OUTPUT_COST = 2,
+    };
+
+    // Search run by a query. JPS prunes symmetric paths on uniform-cost
+    // 8-connected grids and returns the same full path as A*.
+    // SEARCH_BIDIRECTIONAL grows frontiers from src and dest until they meet.
+    // SEARCH_ALT is A* bounded by distances to landmark cells, which are
+    // computed once per grid.
+    // SEARCH_KBEST expands several of the best open cells per step, see
+    // KBEST_LANES.
+    enum searchAlgorithm
+    {
+        SEARCH_ASTAR = 0,
+        SEARCH_JPS = 1,
+        SEARCH_BIDIRECTIONAL = 2,
+        SEARCH_ALT = 3,
+        SEARCH_KBEST = 4,
+    };
+
+    // length is the number of waypoints from src to dest inclusive, 0 when
+    // no path was found. expanded counts the cells taken off the open list.
+    struct pathSummary
+    {
+        int length;
+
+        double cost;
+
+        int expanded;
+    };
+
+    // One query of a batch; search picks the algorithm as for asearch().
+    struct query
+    {
+        Pair src;
+
+        Pair dest;
+
+        int search;
+    };
+
+    // Per-query output of asearch_batch. In path mode the waypoints start
+    // at pathOut[offset]. A path that does not fit in what is left of
+    // pathOut comes back as PATH_OUTPUT_FULL with its summary filled in.
+    struct queryResult
+    {
+        result r;
+
+        pathSummary summary;
+
+        int offset;
+    };
+
+    // Generic kernel: any grid up to MAX_ROW x MAX_COL, 8-connected.
+    void asearch(unsigned int grid[], int rows, int cols, Pair src, Pair dest, int search, int mode, result* r, pathSummary* summary, Pair pathOut[], cell cellDetails[]);
+
+    // Fixed-size kernels, named <rows>x<cols>_<connectivity>c. They reject
+    // any other grid size with INVALID_GRID_SIZE.
+    void asearch_64x64_8c(unsigned int grid[], int rows, int cols, Pair src, Pair dest, int search, int mode, result* r, pathSummary* summary, Pair pathOut[], cell cellDetails[]);
+
+    void asearch_32x32_4c(unsigned int grid[], int rows, int cols, Pair src, Pair dest, int search, int mode, result* r, pathSummary* summary, Pair pathOut[], cell cellDetails[]);
+
+    // A cell whose blocked state changed since the last asearch_replan call.
+    struct cellChange
+    {
+        Pair cell;
+
+        int unblocked;
+    };
+
+    // Runs count queries against one grid upload. mode is OUTPUT_PATH or
+    // OUTPUT_COST; details are not available per query.
+    void asearch_batch(unsigned int grid[], int rows, int cols, int count, query queries[], int mode, queryResult results[], Pair pathOut[], int pathCapacity);
+
+    // Words of the asearch_serve doorbell. The host bumps DOORBELL_TAIL to
+    // the number of queries it has put in the ring so far, and sets
+    // DOORBELL_STOP once it has put in the last one.
+    enum serveDoorbell
+    {
+        DOORBELL_TAIL = 0,
+        DOORBELL_STOP = 1
     };
 
-    void asearch(int grid[], Pair src, Pair dest, result* r, cell cellDetails[]);
+    // Persistent kernel, started once. Query n goes in ring slot
+    // n % ringSize; the kernel answers it into results and the slot's
+    // rows * cols waypoints of pathOut, then sets done[slot] to n + 1. It
+    // returns after the last query once DOORBELL_STOP is set, or at once
+    // if ringSize is below 1. mode is OUTPUT_PATH or OUTPUT_COST.
+    void asearch_serve(unsigned int grid[], int rows, int cols, query ring[], volatile int doorbell[], queryResult results[], volatile int done[], Pair pathOut[], int ringSize, int mode);
+
+    // Incremental planner (D* Lite). The search tree towards dest stays on
+    // chip between calls. A call with reset set, or one with a new dest
+    // or grid size, plans from grid; any other call ignores grid, applies
+    // changes and repairs only what they affect. src is where the robot is
+    // now and may move freely between calls. mode is OUTPUT_PATH or
+    // OUTPUT_COST, and expanded counts the cells this call processed.
+    void asearch_replan(unsigned int grid[], int rows, int cols, Pair src, Pair dest, int reset, cellChange changes[], int changeCount, int mode, result* r, pathSummary* summary, Pair pathOut[]);
+
+    enum hpaRebuild
+    {
+        HPA_KEEP = 0,
+        HPA_REBUILD_ALL = 1,
+        HPA_REBUILD_CLUSTER = 2,
+    };
+
+    // Hierarchical search (HPA*). Cluster entrances and the distances
+    // between them stay on chip, so a query searches the entrance graph
+    // and then refines each hop inside one cluster. HPA_REBUILD_CLUSTER
+    // re-reads from grid only the cluster holding changed; the first call
+    // or a new grid size rebuilds everything. mode is OUTPUT_PATH or
+    // OUTPUT_COST.
+    void asearch_hpa(unsigned int grid[], int rows, int cols, int rebuild, Pair changed, Pair src, Pair dest, int mode, result* r, pathSummary* summary, Pair pathOut[]);
 }
 
+// Direction of the move that reached a cell, from its parent. Diagonal
+// moves are DIR_NE and above.
+enum direction
+{
+    DIR_N = 0,
+    DIR_S = 1,
+    DIR_E = 2,
+    DIR_W = 3,
+    DIR_NE = 4,
+    DIR_NW = 5,
+    DIR_SE = 6,
+    DIR_SW = 7,
+};
 
-bool isValid(int row, int col);
+// Heuristic policies: a lower bound on the cost of a move rowDiff rows
+// and colDiff columns away in a CONN-connected search, with straight
+// steps costing 1 and diagonal ones 1.414. Octile is the exact cost on
+// open ground and needs no sqrt. Manhattan only bounds 4-connected
+// searches.
+struct octileHeuristic
+{
+    template <typename cost_t, int CONN>
+    static cost_t value(int rowDiff, int colDiff)
+    {
+        int lo = rowDiff < colDiff ? rowDiff : colDiff;
+        int hi = rowDiff < colDiff ? colDiff : rowDiff;
+        return CONN == 8 ? hi + cost_t(0.414) * lo : cost_t(hi + lo);
+    }
+};
 
-bool isUnBlocked(int grid[][COL], int row, int col);
+struct manhattanHeuristic
+{
+    template <typename cost_t, int CONN>
+    static cost_t value(int rowDiff, int colDiff)
+    {
+        return rowDiff + colDiff;
+    }
+};
+
+struct chebyshevHeuristic
+{
+    template <typename cost_t, int CONN>
+    static cost_t value(int rowDiff, int colDiff)
+    {
+        return rowDiff > colDiff ? rowDiff : colDiff;
+    }
+};
+
+struct euclideanHeuristic
+{
+    template <typename cost_t, int CONN>
+    static cost_t value(int rowDiff, int colDiff)
+    {
+        return sqrt(cost_t(rowDiff * rowDiff + colDiff * colDiff));
+    }
+};
+
+// Policies of the 8-connected kernels and of the 4-connected one, picked
+// by the CONN each kernel instantiates. Euclidean reproduces the golden
+// output; a policy with equally tight bounds can break ties between
+// equal paths differently.
+#ifndef ASEARCH_HEURISTIC
+#define ASEARCH_HEURISTIC euclideanHeuristic
+#endif
+#ifndef ASEARCH_HEURISTIC_4C
+#define ASEARCH_HEURISTIC_4C ASEARCH_HEURISTIC
+#endif
+
+template <int CONN>
+struct connHeuristic
+{
+    typedef ASEARCH_HEURISTIC type;
+    static_assert(!std::is_same<type, manhattanHeuristic>::value, "manhattanHeuristic overestimates diagonal steps; set it for the 4-connected kernel only");
+};
+
+template <>
+struct connHeuristic<4>
+{
+    typedef ASEARCH_HEURISTIC_4C type;
+};
+
+// Indexed binary min-heap keyed on f. pos holds each cell's slot in
+// nodes, or -1 when the cell is not on the open list.
+template <typename cost_t, int R, int C, int CAP>
+struct openHeap
+{
+    pair<cost_t, Pair> nodes[CAP];
+    int pos[R][C];
+    int size;
+};
+
+// Search state kept between calls of a kernel. A cell's g, open list
+// position and closed bit only hold while its stamp matches generation;
+// older cells read as unreached, so a new query clears nothing up front.
+// parent is only read along paths of the current query.
+template <typename cost_t, int R, int C, int OPEN>
+struct searchWorkspace
+{
+    cost_t g[R][C];
+    unsigned int parent[R][PARENT_WORDS(C)];
+    unsigned int closed[R][GRID_WORDS(C)];
+    unsigned short stamp[R][C];
+    unsigned short generation;
+    openHeap<cost_t, R, C, OPEN> openList;
+};
+
+// Exact distances from ALT_LANDMARKS cells to every cell of grid. They
+// are rebuilt only when a query brings a different grid, and each
+// landmark has its own open list so the tables fill in parallel.
+template <typename cost_t, int R, int C>
+struct landmarkTable
+{
+    cost_t dist[ALT_LANDMARKS][R][C];
+    unsigned int grid[R][GRID_WORDS(C)];
+    openHeap<cost_t, R, C, R * C> openList[ALT_LANDMARKS];
+    int rows;
+    int cols;
+    bool ready;
+};
+
+// D* Lite queue key, ordered on k1 and then k2.
+template <typename cost_t>
+struct lpaKey
+{
+    cost_t k1;
+    cost_t k2;
+};
+
+// asearch_replan state. g and rhs are costs to dest; a cell is
+// inconsistent, and queued, while they differ. last is src at the
+// previous call, km the heuristic drift built up since the reset.
+template <typename cost_t, int R, int C, int OPEN>
+struct replanState
+{
+    cost_t g[R][C];
+    cost_t rhs[R][C];
+    unsigned int grid[R][GRID_WORDS(C)];
+    openHeap<lpaKey<cost_t>, R, C, OPEN> openList;
+    int rows;
+    int cols;
+    Pair dest;
+    Pair last;
+    cost_t km;
+    bool ready;
+};
+
+// asearch_hpa state. Abstract nodes are (cluster, slot) pairs. Slot
+// side * HPA_ENTRANCES + e is entrance e on side DIR_N, DIR_S, DIR_E or
+// DIR_W, with the same e on both clusters of a border, and the two slots
+// after HPA_SLOTS stand for src and dest during a query. A slot is
+// unused while its entrance row is -1. dist holds the cost between two
+// entrances of a cluster without leaving it, and route the parent
+// directions of the search from each entrance, so refining a hop needs
+// no search. local and localDir hold the last search inside a cluster.
+template <typename cost_t, int R, int C>
+struct hpaState
+{
+    unsigned int grid[R][GRID_WORDS(C)];
+    Pair entrance[HPA_CLUSTERS(R) * HPA_CLUSTERS(C)][HPA_SLOTS];
+    cost_t dist[HPA_CLUSTERS(R) * HPA_CLUSTERS(C)][HPA_SLOTS][HPA_SLOTS];
+    cost_t srcDist[HPA_SLOTS + 2];
+    cost_t destDist[HPA_SLOTS + 2];
+    cost_t g[HPA_CLUSTERS(R) * HPA_CLUSTERS(C)][HPA_SLOTS + 2];
+    Pair parent[HPA_CLUSTERS(R) * HPA_CLUSTERS(C)][HPA_SLOTS + 2];
+    Pair chain[HPA_CLUSTERS(R) * HPA_CLUSTERS(C) * (HPA_SLOTS + 2)];
+    openHeap<cost_t, HPA_CLUSTERS(R) * HPA_CLUSTERS(C), HPA_SLOTS + 2, HPA_CLUSTERS(R) * HPA_CLUSTERS(C) * (HPA_SLOTS + 2)> openList;
+    unsigned char route[HPA_CLUSTERS(R) * HPA_CLUSTERS(C)][HPA_SLOTS][HPA_CLUSTER][HPA_CLUSTER];
+    unsigned char srcRoute[HPA_CLUSTER][HPA_CLUSTER];
+    unsigned char destRoute[HPA_CLUSTER][HPA_CLUSTER];
+    cost_t local[HPA_CLUSTER][HPA_CLUSTER];
+    unsigned char localDir[HPA_CLUSTER][HPA_CLUSTER];
+    openHeap<cost_t, HPA_CLUSTER, HPA_CLUSTER, HPA_CLUSTER * HPA_CLUSTER> localOpen;
+    int rows;
+    int cols;
+    bool ready;
+};
+
+// Search core shared by all kernels. R x C sizes the on-chip arrays,
+// CONN is 4 or 8 and OPEN is the open list capacity.
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void searchCore(unsigned int gridIn[], int rows, int cols, Pair src, Pair dest, int search, int mode, result* res, pathSummary* summary, Pair pathOut[], cell cellOut[]);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void batchCore(unsigned int gridIn[], int rows, int cols, int count, query queries[], int mode, queryResult results[], Pair pathOut[], int pathCapacity);
+
+// asearch_batch as three dataflow stages: read the queries, search them,
+// write the results and packed paths back. mode is OUTPUT_PATH or
+// OUTPUT_COST.
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void batchDataflow(unsigned int gridIn[], int rows, int cols, int count, query queries[], int mode, queryResult results[], Pair pathOut[], int pathCapacity);
+
+void loadQueries(int count, query queries[], hls::stream<query>& queryStream);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void searchQueries(unsigned int gridIn[], int rows, int cols, int count, int mode, hls::stream<query>& queryStream, hls::stream<queryResult>& resultStream, hls::stream<Pair>& pathStream);
+
+void storeResults(int count, int mode, hls::stream<queryResult>& resultStream, hls::stream<Pair>& pathStream, queryResult results[], Pair pathOut[], int pathCapacity);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void serveCore(unsigned int gridIn[], int rows, int cols, query ring[], volatile int doorbell[], queryResult results[], volatile int done[], Pair pathOut[], int ringSize, int mode);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void searchGrid(unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, int search, int mode, result* res, pathSummary* summary, Pair pathOut[], int pathCapacity, cell cellOut[]);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+bool astarSearch(searchWorkspace<cost_t, R, C, OPEN>* ws, landmarkTable<cost_t, R, C>* lm, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, bool* openFull, int* expanded);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+bool kbestSearch(searchWorkspace<cost_t, R, C, OPEN>* ws, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, bool* openFull, int* expanded);
+
+template <int R, int C, typename cost_t, int OPEN>
+bool jpsSearch(searchWorkspace<cost_t, R, C, OPEN>* ws, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, bool* openFull, int* expanded);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+bool bidirectionalSearch(searchWorkspace<cost_t, R, C, OPEN>* ws, searchWorkspace<cost_t, R, C, OPEN>* back, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair src, Pair dest, bool* openFull, int* expanded);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+bool expandSide(searchWorkspace<cost_t, R, C, OPEN>* ws, searchWorkspace<cost_t, R, C, OPEN>* other, unsigned int grid[][GRID_WORDS(C)], int rows, int cols, Pair start, Pair goal, cost_t* best, Pair* meet);
+
+template <int CONN, typename cost_t, int R, int C>
+void updateLandmarks(landmarkTable<cost_t, R, C>* lm, unsigned int grid[][GRID_WORDS(C)], int rows, int cols);
+
+template <int CONN, typename cost_t, int R, int C>
+void landmarkDistances(landmarkTable<cost_t, R, C>* lm, int k, Pair from);
+
+template <int CONN, typename cost_t, int R, int C>
+cost_t heuristicValue(landmarkTable<cost_t, R, C>* lm, int row, int col, Pair dest);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void replanCore(unsigned int gridIn[], int rows, int cols, Pair src, Pair dest, int reset, cellChange changes[], int changeCount, int mode, result* res, pathSummary* summary, Pair pathOut[]);
+
+template <int CONN, typename cost_t, int R, int C, int OPEN>
+bool computeShortestPath(replanState<cost_t, R, C, OPEN>* st, Pair start, int* expanded);
+
+template <int CONN, typename cost_t, int R, int C, int OPEN>
+bool updateVertex(replanState<cost_t, R, C, OPEN>* st, Pair start, int row, int col);
+
+template <int CONN, typename cost_t, int R, int C, int OPEN>
+lpaKey<cost_t> calculateKey(replanState<cost_t, R, C, OPEN>* st, Pair start, int row, int col);
+
+template <int CONN, typename cost_t>
+cost_t replanHValue(int row, int col, Pair start);
+
+template <typename cost_t>
+bool operator<(const lpaKey<cost_t>& a, const lpaKey<cost_t>& b);
+
+template <typename cost_t>
+bool operator<=(const lpaKey<cost_t>& a, const lpaKey<cost_t>& b);
+
+template <int R, int C, int CONN, typename cost_t, int OPEN>
+void hpaCore(unsigned int gridIn[], int rows, int cols, int rebuild, Pair changed, Pair src, Pair dest, int mode, result* res, pathSummary* summary, Pair pathOut[]);
+
+template <int CONN, typename cost_t, int R, int C>
+void buildCluster(hpaState<cost_t, R, C>* st, int cluster);
+
+template <typename cost_t, int R, int C>
+void findEntrances(hpaState<cost_t, R, C>* st, int first, int second, bool vertical);
+
+template <int CONN, typename cost_t, int R, int C>
+int clusterSearch(hpaState<cost_t, R, C>* st, int cluster, Pair from, Pair dest);
+
+template <typename cost_t, int R, int C>
+cost_t clusterDistance(hpaState<cost_t, R, C>* st, int cluster, Pair to);
+
+template <typename cost_t, int R, int C>
+Pair nodeCell(hpaState<cost_t, R, C>* st, Pair node, Pair src, Pair dest);
+
+template <int CONN, typename cost_t, int R, int C>
+void relaxNode(hpaState<cost_t, R, C>* st, Pair from, Pair to, cost_t w, Pair src, Pair dest);
+
+template <int C, typename cost_t>
+int refineHop(int cluster, unsigned char route[][HPA_CLUSTER], Pair from, Pair to, bool fromRoot, Pair pathOut[], int length, int capacity, bool writePath, cost_t* cost);
+
+void setResult(result* res, pathSummary* summary, result r);
+
+template <int W>
+void loadGrid(unsigned int gridIn[], int rows, int cols, unsigned int grid[][W]);
+
+bool isValid(int row, int col, int rows, int cols);
+
+template <int W>
+bool isUnBlocked(unsigned int grid[][W], int row, int col);
+
+template <int W>
+bool testBit(unsigned int bits[][W], int row, int col);
+
+template <int W>
+void setBit(unsigned int bits[][W], int row, int col);
+
+template <int W>
+void clearBit(unsigned int bits[][W], int row, int col);
+
+// Reads the words of bits that hold columns col - 1 and col + 1 of the
+// three rows around row, so lo[r] and hi[r] cover that row's part of
+// the 3x3 block. Rows outside the grid read as 0.
+template <int W>
+void readNeighbourWords(unsigned int bits[][W], int row, int col, int rows, int cols, unsigned int lo[3], unsigned int hi[3]);
+
+// Bit col of block row r from readNeighbourWords around column centre.
+bool neighbourBit(const unsigned int lo[3], const unsigned int hi[3], int r, int centre, int col);
+
+template <int W>
+int getParent(unsigned int parent[][W], int row, int col);
+
+template <int W>
+void setParent(unsigned int parent[][W], int row, int col, int dir);
 
 bool isDestination(int row, int col, Pair dest);
 
-double calculateHValue(int row, int col, Pair dest);
+template <int W>
+bool isPassable(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col);
+
+template <int W>
+bool hasForcedNeighbour(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col, int dir);
+
+template <int W>
+bool isJumpDirection(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col, int from, int dir);
+
+template <int W>
+bool jumpStraight(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col, int dir);
+
+template <int W>
+bool jump(unsigned int grid[][W], int rows, int cols, Pair dest, int row, int col, int dir, int* jumpI, int* jumpJ);
+
+template <typename cost_t, int CONN>
+cost_t calculateHValue(int row, int col, Pair dest);
+
+//void tracePath(result r, cell cellDetails[], int cols, Pair dest);
+
+bool readGrid(const char* file, int grid[], int rows, int cols);
+
+template <typename cost_t>
+bool checkF(cost_t g, cost_t h, cost_t f);
+
+template <typename cost_t, int R, int C>
+int buildPath(unsigned int parent[][PARENT_WORDS(C)], Pair src, Pair dest, Pair pathOut[], bool writePath, int capacity, cost_t* cost);
 
-//void tracePath(result r, cell cellDetails[][COL], Pair dest);
+template <typename cost_t, int R, int C, int OPEN>
+void beginQuery(searchWorkspace<cost_t, R, C, OPEN>* ws);
 
-void readGrid(const char* file, int grid[][COL]);
+template <typename cost_t, int R, int C, int OPEN>
+void touch(searchWorkspace<cost_t, R, C, OPEN>* ws, int row, int col);
 
-bool checkF(cell cellDetails[][COL], int i, int j, double f);
+template <typename cost_t, int R, int C, int CAP>
+bool checkForEmpty(openHeap<cost_t, R, C, CAP>* heap);
 
-void init(pPair* list);
+template <typename cost_t, int R, int C, int CAP>
+pair<cost_t, Pair> getNext(openHeap<cost_t, R, C, CAP>* heap);
 
-bool checkForEmpty(pPair* list);
+template <typename cost_t, int R, int C, int CAP>
+bool addPPair(openHeap<cost_t, R, C, CAP>* heap, const pair<cost_t, Pair>& pair);
 
-void getNext(pPair* list, int* index);
+template <typename cost_t, int R, int C, int CAP>
+void removePPair(openHeap<cost_t, R, C, CAP>* heap, Pair cell);
 
-void addPPair(pPair* list, const pPair& pair);
+template <typename cost_t, int R, int C, int CAP>
+void siftUp(openHeap<cost_t, R, C, CAP>* heap, int index);
 
-void removePPair(pPair* list, int index);
+template <typename cost_t, int R, int C, int CAP>
+void siftDown(openHeap<cost_t, R, C, CAP>* heap, int index);
 
 #endif
@@ -0,0 +1,43 @@
+/*
+* Stand-in for hls::stream when the kernel is built for the CPU without
+* the Vitis headers. The dataflow stages run one after another there, so
+* a queue is all a stream has to be.
+*/
+#ifndef ASEARCH_NATIVE_STREAM_H_
+#define ASEARCH_NATIVE_STREAM_H_
+
+#include <deque>
+
+namespace hls
+{
+    template <typename T>
+    class stream
+    {
+    public:
+        stream() {}
+
+        explicit stream(const char* name) {}
+
+        void write(const T& value)
+        {
+            fifo.push_back(value);
+        }
+
+        T read()
+        {
+            T value = fifo.front();
+            fifo.pop_front();
+            return value;
+        }
+
+        bool empty() const
+        {
+            return fifo.empty();
+        }
+
+    private:
+        std::deque<T> fifo;
+    };
+}
+
+#endif
@@ -13,13 +13,20 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#ifdef ASEARCH_NATIVE
+#include "asearch_cpu.h"
+#endif
 
+int checkGolden(const char* obsFile, const char* expFile);
 bool cmpLine(const string& str1, const string& str2);
-void tracePath(result r, cell cellDetails[][COL], Pair dest);
+void writePath(result r, Pair path[], int length);
+void packGrid(const int grid[], int rows, int cols, unsigned int packed[]);
 
 int main()
 {
-    int grid[ROW][COL] =
+    const int rows = 9;
+    const int cols = 10;
+    int grid[rows][cols] =
     {
         {1,0,1,1,1,1,0,1,1,1},
         {1,1,1,0,1,1,1,0,1,1},
@@ -27,50 +34,272 @@ int main()
         {0,0,1,0,1,0,0,0,0,1},
         {1,1,1,0,1,1,1,0,1,0},
         {1,0,1,1,1,1,0,1,0,0},
+        {1,0,0,0,0,1,0,0,0,1},
         {1,0,1,1,1,1,0,1,1,1},
         {1,1,1,0,0,0,1,0,0,1}
     };
 
-    int gridIn[ROW * COL];
+    int gridIn[rows * cols];
     Pair src = make_pair(8, 0);
     Pair dest = make_pair(0, 0);
     result r = result::PATH_NOT_FOUND;
-    cell detailsOut[ROW * COL];
+    pathSummary summary;
+    Pair pathOut[rows * cols];
+    cell detailsOut[rows * cols];
 
-    for (int i = 0; i < ROW; i++)
+    for (int i = 0; i < rows; i++)
     {
-        for (int j = 0; j < COL; j++)
+        for (int j = 0; j < cols; j++)
         {
-            gridIn[i * COL + j] = grid[i][j];
-            detailsOut[i * COL + j] = cell();
+            gridIn[i * cols + j] = grid[i][j];
+            detailsOut[i * cols + j] = cell();
         }
     }
 
-    std::cout << "Execution of the kernel" << std::endl;
-    asearch(gridIn, src, dest, &r, detailsOut);
+    unsigned int gridPacked[rows * GRID_WORDS(cols)];
+    packGrid(gridIn, rows, cols, gridPacked);
+
+#if OPEN_MAX <= 8
+    // Built with an open list of a few cells (make cpu-test does this
+    // too), the kernels that keep a wide frontier on this grid have to
+    // stop with OPEN_LIST_FULL. JPS, bidirectional and k-best still fit.
+    int fullSearches[2] = { SEARCH_ASTAR, SEARCH_ALT };
+    query fullQueries[2];
+    queryResult fullResults[2];
+    Pair fullPacked[2 * rows * cols];
+    bool full = true;
+    for (int k = 0; k < 2; k++)
+    {
+        asearch(gridPacked, rows, cols, src, dest, fullSearches[k], OUTPUT_PATH, &r, &summary, pathOut, detailsOut);
+        full = full && r == OPEN_LIST_FULL;
+
+        fullQueries[k].src = src;
+        fullQueries[k].dest = dest;
+        fullQueries[k].search = fullSearches[k];
+    }
+
+    asearch_batch(gridPacked, rows, cols, 2, fullQueries, OUTPUT_PATH, fullResults, fullPacked, 2 * rows * cols);
+    full = full && fullResults[0].r == OPEN_LIST_FULL && fullResults[1].r == OPEN_LIST_FULL;
+
+    cellChange noChange;
+    asearch_replan(gridPacked, rows, cols, src, dest, true, &noChange, 0, OUTPUT_PATH, &r, &summary, pathOut);
+    full = full && r == OPEN_LIST_FULL;
+
+    if (!full)
+    {
+        std::cout << "*******************************************" << std::endl;
+        std::cout << "FAIL: Search DID NOT stop with OPEN_LIST_FULL" << std::endl;
+        std::cout << "*******************************************" << std::endl;
+        return 6;
+    }
+
+    std::cout << "*******************************************" << std::endl;
+    std::cout << "PASS: Every search stopped with OPEN_LIST_FULL" << std::endl;
+    std::cout << "*******************************************" << std::endl;
+    return 0;
+#endif
+
+    // Every search has to reproduce the same golden path.
+    int searches[5] = { SEARCH_ASTAR, SEARCH_JPS, SEARCH_BIDIRECTIONAL, SEARCH_ALT, SEARCH_KBEST };
+    for (int k = 0; k < 5; k++)
+    {
+        std::cout << "Execution of the kernel, search " << searches[k] << std::endl;
+        asearch(gridPacked, rows, cols, src, dest, searches[k], OUTPUT_PATH, &r, &summary, pathOut, detailsOut);
+
+        writePath(r, pathOut, summary.length);
+
+        int status = checkGolden("out.dat", "out.gold.aStarSearch.dat");
+        if (status != 0)
+        {
+            return status;
+        }
+    }
+
+    // A batch of the same query once per search has to pack three copies
+    // of the golden path back to back.
+    query queries[3];
+    queryResult results[3];
+    Pair packed[3 * rows * cols];
+    for (int k = 0; k < 3; k++)
+    {
+        queries[k].src = src;
+        queries[k].dest = dest;
+        queries[k].search = searches[k];
+    }
+
+    std::cout << "Execution of the batch kernel" << std::endl;
+    asearch_batch(gridPacked, rows, cols, 3, queries, OUTPUT_PATH, results, packed, 3 * rows * cols);
+
+    for (int k = 0; k < 3; k++)
+    {
+        writePath(results[k].r, packed + results[k].offset, results[k].summary.length);
+
+        int status = checkGolden("out.dat", "out.gold.aStarSearch.dat");
+        if (status != 0)
+        {
+            return status;
+        }
+    }
 
-    cell details[ROW][COL];
-    for (int i = 0; i < ROW; i++)
+    // The persistent kernel has to return at once without a ring slot,
+    // even though stop is not set.
+    int doorbell[2] = { 0, 0 };
+    int done[3] = { 0, 0, 0 };
+    asearch_serve(gridPacked, rows, cols, queries, doorbell, results, done, packed, 0, OUTPUT_PATH);
+
+    // With the same three queries already in its ring and stop set, it
+    // answers them all and returns.
+    doorbell[DOORBELL_TAIL] = 3;
+    doorbell[DOORBELL_STOP] = 1;
+    std::cout << "Execution of the persistent kernel" << std::endl;
+    asearch_serve(gridPacked, rows, cols, queries, doorbell, results, done, packed, 3, OUTPUT_PATH);
+
+    for (int k = 0; k < 3; k++)
     {
-        for (int j = 0; j < COL; j++)
+        if (done[k] != k + 1)
+        {
+            std::cout << "*******************************************" << std::endl;
+            std::cout << "FAIL: Persistent kernel did not complete query " << k << std::endl;
+            std::cout << "*******************************************" << std::endl;
+            return 5;
+        }
+
+        writePath(results[k].r, packed + results[k].offset, results[k].summary.length);
+
+        int status = checkGolden("out.dat", "out.gold.aStarSearch.dat");
+        if (status != 0)
         {
-            details[i][j] = detailsOut[i * COL + j];
+            return status;
         }
     }
 
-    tracePath(r, details, dest);
+    // The incremental planner breaks ties between equal paths its own way,
+    // so it has to match cost and length rather than the path: the golden
+    // ones from scratch and after the blocked cell is cleared again, and
+    // a full plan on the updated grid while (4,1) on the path is blocked.
+    pathSummary golden = summary;
+    pathSummary blocked;
+    gridIn[4 * cols + 1] = 0;
+    unsigned int blockedPacked[rows * GRID_WORDS(cols)];
+    packGrid(gridIn, rows, cols, blockedPacked);
+    gridIn[4 * cols + 1] = 1;
+    asearch(blockedPacked, rows, cols, src, dest, SEARCH_ASTAR, OUTPUT_COST, &r, &blocked, pathOut, detailsOut);
+
+    cellChange change;
+    change.cell = make_pair(4, 1);
+    for (int k = 0; k < 3; k++)
+    {
+        change.unblocked = k == 2;
+        pathSummary expected = k == 1 ? blocked : golden;
+
+        std::cout << "Execution of the replan kernel, step " << k << std::endl;
+        asearch_replan(gridPacked, rows, cols, src, dest, k == 0, &change, k == 0 ? 0 : 1, OUTPUT_PATH, &r, &summary, pathOut);
 
+        if (r != FOUND_PATH || summary.length != expected.length || fabs(summary.cost - expected.cost) > 1e-6)
+        {
+            std::cout << "*******************************************" << std::endl;
+            std::cout << "FAIL: Replanned path DOES NOT match the expected cost" << std::endl;
+            std::cout << "*******************************************" << std::endl;
+            return 4;
+        }
+    }
+
+    // The hierarchical search has to find the golden path from a full
+    // build and again after rebuilding the cluster holding src.
+    for (int k = 0; k < 2; k++)
+    {
+        std::cout << "Execution of the hierarchical kernel, step " << k << std::endl;
+        asearch_hpa(gridPacked, rows, cols, k == 0 ? HPA_REBUILD_ALL : HPA_REBUILD_CLUSTER, src, src, dest, OUTPUT_PATH, &r, &summary, pathOut);
+
+        writePath(r, pathOut, summary.length);
+
+        int status = checkGolden("out.dat", "out.gold.aStarSearch.dat");
+        if (status != 0)
+        {
+            return status;
+        }
+    }
+
+#ifdef ASEARCH_NATIVE
+    // Built natively (make cpu-test), the CPU library has to give the
+    // golden path for one search and for a batch.
+    cpuBackend backend;
+    backend.setGrid(std::vector<int>(gridIn, gridIn + rows * cols), rows, cols);
+    cpuCell cpuSrc = { src.first, src.second };
+    cpuCell cpuDest = { dest.first, dest.second };
+    cpuSummary cpuOut;
+    std::vector<cpuCell> cpuPath;
+
+    std::cout << "Execution of the CPU library" << std::endl;
+    r = (result)backend.search(cpuSrc, cpuDest, CPU_SEARCH_ASTAR, CPU_OUTPUT_PATH, cpuOut, cpuPath);
+    for (int i = 0; i < (int)cpuPath.size(); i++)
+    {
+        pathOut[i] = make_pair(cpuPath[i].row, cpuPath[i].col);
+    }
+
+    writePath(r, pathOut, cpuOut.length);
+
+    int cpuStatus = checkGolden("out.dat", "out.gold.aStarSearch.dat");
+    if (cpuStatus != 0)
+    {
+        return cpuStatus;
+    }
+
+    std::vector<cpuQuery> cpuQueries(3);
+    std::vector<cpuQueryResult> cpuResults;
+    for (int k = 0; k < 3; k++)
+    {
+        cpuQueries[k].src = cpuSrc;
+        cpuQueries[k].dest = cpuDest;
+        cpuQueries[k].search = searches[k];
+    }
+
+    std::cout << "Execution of the CPU library, batch" << std::endl;
+    backend.batch(cpuQueries, CPU_OUTPUT_PATH, cpuResults, cpuPath);
+    for (int k = 0; k < 3; k++)
+    {
+        for (int i = 0; i < cpuResults[k].summary.length; i++)
+        {
+            cpuCell c = cpuPath[cpuResults[k].offset + i];
+            pathOut[i] = make_pair(c.row, c.col);
+        }
+
+        writePath((result)cpuResults[k].result, pathOut, cpuResults[k].summary.length);
+
+        cpuStatus = checkGolden("out.dat", "out.gold.aStarSearch.dat");
+        if (cpuStatus != 0)
+        {
+            return cpuStatus;
+        }
+    }
+#endif
+
+    std::cout << "*******************************************" << std::endl;
+    std::cout << "PASS: The output matches the golden output" << std::endl;
+    std::cout << "*******************************************" << std::endl;
+
+    return 0;
+}
+
+int checkGolden(const char* obsFile, const char* expFile)
+{
     std::cout << "Comparing observed against expected data" << std::endl;
 
     std::ifstream file_obs, file_exp;
-    file_obs.open("out.dat");
-    file_exp.open("out.gold.aStarSearch.dat");
-    bool hasDataObs = file_obs.eof();
-    bool hasDataExp = file_exp.eof();
+    file_obs.open(obsFile);
+    file_exp.open(expFile);
 
     std::string obs, exp;
-    for (unsigned int i = 1; hasDataObs || hasDataExp; i++)
+    for (unsigned int i = 1; ; i++)
     {
+        bool hasDataObs = static_cast<bool>(std::getline(file_obs, obs));
+        bool hasDataExp = static_cast<bool>(std::getline(file_exp, exp));
+
+        if (!hasDataObs && !hasDataExp)
+        {
+            break;
+        }
+
         if (hasDataExp && !hasDataObs) // They don't agree on number of line in output
         {
             std::cout << "*******************************************" << std::endl;
@@ -89,10 +318,6 @@ int main()
             return 3;
         }
 
-        std::getline(file_obs, obs);
-
-        std::getline(file_exp, exp);
-
         if (!cmpLine(obs, exp)) // compare the data
         {
             std::cout << "*******************************************" << std::endl;
@@ -102,14 +327,7 @@ int main()
             std::cout << "*******************************************" << std::endl;
             return 1;
         }
-
-        hasDataObs = file_obs.eof();
-        hasDataExp = file_exp.eof();
-    } while (hasDataObs && hasDataExp);
-
-    std::cout << "*******************************************" << std::endl;
-    std::cout << "PASS: The output matches the golden output" << std::endl;
-    std::cout << "*******************************************" << std::endl;
+    }
 
     return 0;
 }
@@ -131,16 +349,12 @@ bool cmpLine(const string& str1, const string& str2)
     return match;
 }
 
-void tracePath(result r, cell cellDetails[][COL], Pair dest)
+void writePath(result r, Pair path[], int length)
 {
     std::cout << "Result: " << r << endl;
-    //    std::cout << "Dest: " << dest << endl;
     std::ofstream output;
-    int row = dest.first;
-    int col = dest.second;
 
     output.open("out.dat", std::ofstream::trunc);
-    Pair Path[ROW * COL];
 
     switch (r)
     {
@@ -150,24 +364,9 @@ void tracePath(result r, cell cellDetails[][COL], Pair dest)
 
             output << "The Path is " << std::endl;
 
-            int idx = 0;
-            while (!(cellDetails[row][col].parent_i == row &&
-                cellDetails[row][col].parent_j == col))
-            {
-                Path[idx] = make_pair(row, col);
-                idx++;
-                int tempRow = cellDetails[row][col].parent_i;
-                int tempCol = cellDetails[row][col].parent_j;
-                row = tempRow;
-                col = tempCol;
-            }
-
-
-            Path[idx] = make_pair(row, col);
-            for (int i = idx; i << idx >= 0; i--)
+            for (int i = 0; i < length; i++)
             {
-                Pair p = Path[i];
-                output << "(" << p.first << "," << p.second << ")" << endl;
+                output << "(" << path[i].first << "," << path[i].second << ")" << endl;
             }
         }
         break;
@@ -191,8 +390,40 @@ void tracePath(result r, cell cellDetails[][COL], Pair dest)
         case PATH_NOT_FOUND:
             output << "Path was not found";
             break;
+
+        case OPEN_LIST_FULL:
+            output << "Open list capacity exceeded";
+            break;
+
+        case INVALID_GRID_SIZE:
+            output << "Grid size is invalid";
+            break;
+
+        case PATH_OUTPUT_FULL:
+            output << "Path does not fit the output buffer";
+            break;
     }
 
     output.flush();
     output.close();
-}
\ No newline at end of file
+}
+
+void packGrid(const int grid[], int rows, int cols, unsigned int packed[])
+{
+    int words = GRID_WORDS(cols);
+    for (int i = 0; i < rows * words; i++)
+    {
+        packed[i] = 0;
+    }
+
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            if (grid[i * cols + j] == 1)
+            {
+                packed[i * words + j / GRID_WORD_BITS] |= 1u << (j % GRID_WORD_BITS);
+            }
+        }
+    }
+}